@@ -0,0 +1,80 @@
+// SPDX-FileCopyrightText: 2019–2026 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai
+// SPDX-License-Identifier: Apache-2.0
+//
+// Maintainer: Andy Curtis <contactandyc@gmail.com>
+
+/*
+  Measures Mallocs/sec for small allocations at a fixed alignment of 8, 16
+  and 64 bytes, writing the first word of each so that the memory is touched.
+
+    generic  - aml_pool_alloc for 8, aml_pool_aalloc for 16 and 64
+    define   - the inline allocator of an AML_POOL_DEFINE pool
+
+  usage: bench_aml_pool_aligned [allocs] [size]
+*/
+
+#include "a-memory-library/aml_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BLOCK_SIZE (1024 * 1024)
+
+AML_POOL_DEFINE(pool8, 8, BLOCK_SIZE)
+AML_POOL_DEFINE(pool16, 16, BLOCK_SIZE)
+AML_POOL_DEFINE(pool64, 64, BLOCK_SIZE)
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t checksum = 0;
+
+static void report(const char *name, size_t align, size_t allocs,
+                   double start, void *last) {
+  double elapsed = now_sec() - start;
+  checksum += (size_t)last;
+  printf("%8s %4zu %10.2f\n", name, align, allocs / elapsed / 1e6);
+}
+
+/* each pair runs the same loop, the pool is cleared in between so that both
+   reuse the blocks the first one allocated */
+#define RUN(align, generic_alloc, define_alloc)                               \
+  do {                                                                        \
+    aml_pool_clear(pool);                                                     \
+    double start = now_sec();                                                 \
+    size_t *p = NULL;                                                         \
+    for (size_t i = 0; i < allocs; i++) {                                     \
+      p = (size_t *)(generic_alloc);                                          \
+      *p = i;                                                                 \
+    }                                                                         \
+    report("generic", align, allocs, start, p);                               \
+    aml_pool_clear(pool);                                                     \
+    start = now_sec();                                                        \
+    for (size_t i = 0; i < allocs; i++) {                                     \
+      p = (size_t *)(define_alloc);                                           \
+      *p = i;                                                                 \
+    }                                                                         \
+    report("define", align, allocs, start, p);                                \
+  } while (0)
+
+int main(int argc, char **argv) {
+  size_t allocs = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000;
+  size_t size = argc > 2 ? strtoul(argv[2], NULL, 10) : 24;
+  if (size < sizeof(size_t))
+    size = sizeof(size_t);
+
+  printf("%zu allocations of %zu bytes (Mallocs/sec)\n", allocs, size);
+
+  /* one pool serves all three, the types only differ in their allocators */
+  aml_pool_t *pool = pool8_init();
+  RUN(8, aml_pool_alloc(pool, size), pool8_alloc(pool, size));
+  RUN(16, aml_pool_aalloc(pool, 16, size), pool16_alloc(pool, size));
+  RUN(64, aml_pool_aalloc(pool, 64, size), pool64_alloc(pool, size));
+  aml_pool_destroy(pool);
+  return checksum == 0;
+}
@@ -0,0 +1,97 @@
+// SPDX-FileCopyrightText: 2019–2026 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai
+// SPDX-License-Identifier: Apache-2.0
+//
+// Maintainer: Andy Curtis <contactandyc@gmail.com>
+
+/*
+  Measures nodes/sec for creating many small same-sized nodes, linking each
+  one to the previous so that the memory is touched.
+
+    loop   - aml_pool_alloc once per node
+    batch  - aml_pool_alloc_batch for groups of nodes
+    array  - aml_pool_alloc_array for groups of nodes
+
+  usage: bench_aml_pool_batch [nodes] [size] [group]
+*/
+
+#include "a-memory-library/aml_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef struct node_s {
+  struct node_s *next;
+} node_t;
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+  size_t nodes = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000;
+  size_t size = argc > 2 ? strtoul(argv[2], NULL, 10) : 24;
+  size_t group = argc > 3 ? strtoul(argv[3], NULL, 10) : 256;
+  /* keeps the nodes of the array aligned */
+  size = (size + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1);
+  if (size < sizeof(node_t))
+    size = sizeof(node_t);
+  if (group < 1)
+    group = 1;
+  void **ptrs = (void **)malloc(sizeof(void *) * group);
+  size_t checksum = 0;
+
+  printf("%zu nodes of %zu bytes, groups of %zu (Mnodes/sec)\n", nodes, size,
+         group);
+
+  aml_pool_t *pool = aml_pool_init(1024 * 1024);
+  node_t *prev = NULL;
+  double start = now_sec();
+  for (size_t i = 0; i < nodes; i++) {
+    node_t *n = (node_t *)aml_pool_alloc(pool, size);
+    n->next = prev;
+    prev = n;
+  }
+  double elapsed = now_sec() - start;
+  checksum += (size_t)prev;
+  printf("%8s %10.2f\n", "loop", nodes / elapsed / 1e6);
+
+  aml_pool_clear(pool);
+  prev = NULL;
+  start = now_sec();
+  for (size_t i = 0; i < nodes; i += group) {
+    size_t n = nodes - i < group ? nodes - i : group;
+    aml_pool_alloc_batch(pool, n, size, ptrs);
+    for (size_t j = 0; j < n; j++) {
+      node_t *node = (node_t *)ptrs[j];
+      node->next = prev;
+      prev = node;
+    }
+  }
+  elapsed = now_sec() - start;
+  checksum += (size_t)prev;
+  printf("%8s %10.2f\n", "batch", nodes / elapsed / 1e6);
+
+  aml_pool_clear(pool);
+  prev = NULL;
+  start = now_sec();
+  for (size_t i = 0; i < nodes; i += group) {
+    size_t n = nodes - i < group ? nodes - i : group;
+    char *a = (char *)aml_pool_alloc_array(pool, n, size);
+    for (size_t j = 0; j < n; j++, a += size) {
+      node_t *node = (node_t *)a;
+      node->next = prev;
+      prev = node;
+    }
+  }
+  elapsed = now_sec() - start;
+  checksum += (size_t)prev;
+  printf("%8s %10.2f\n", "array", nodes / elapsed / 1e6);
+
+  aml_pool_destroy(pool);
+  free(ptrs);
+  return checksum == 0;
+}
@@ -0,0 +1,132 @@
+// SPDX-FileCopyrightText: 2019–2026 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai
+// SPDX-License-Identifier: Apache-2.0
+//
+// Maintainer: Andy Curtis <contactandyc@gmail.com>
+
+/*
+  Measures allocations/sec as the number of threads grows from 1 to N for
+  three ways of sharing pool memory between threads.
+
+    per-thread  - each thread allocates from its own aml_pool_init pool
+    concurrent  - all threads share one aml_pool_init_concurrent pool
+    mutex       - all threads share one aml_pool_init pool guarded by a mutex
+
+  usage: bench_aml_pool_concurrent [max_threads] [allocs_per_thread] [size]
+*/
+
+#include "a-memory-library/aml_pool.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef enum { PER_THREAD, CONCURRENT, MUTEX } bench_mode_t;
+
+static const char *mode_names[] = {"per-thread", "concurrent", "mutex"};
+
+typedef struct {
+  bench_mode_t mode;
+  aml_pool_t *shared;
+  pthread_mutex_t *mutex;
+  pthread_barrier_t *barrier;
+  size_t allocs;
+  size_t size;
+  size_t checksum;
+} bench_arg_t;
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *worker(void *p) {
+  bench_arg_t *arg = (bench_arg_t *)p;
+  size_t sum = 0;
+  aml_pool_t *pool = arg->mode == PER_THREAD ? aml_pool_init(1024 * 1024) : arg->shared;
+  pthread_barrier_wait(arg->barrier);
+  for (size_t i = 0; i < arg->allocs; i++) {
+    char *m;
+    if (arg->mode == CONCURRENT)
+      m = (char *)aml_pool_concurrent_alloc(pool, arg->size);
+    else if (arg->mode == MUTEX) {
+      pthread_mutex_lock(arg->mutex);
+      m = (char *)aml_pool_alloc(pool, arg->size);
+      pthread_mutex_unlock(arg->mutex);
+    } else
+      m = (char *)aml_pool_alloc(pool, arg->size);
+    m[0] = (char)i;
+    sum += (size_t)m[0];
+  }
+  arg->checksum = sum;
+  pthread_barrier_wait(arg->barrier);
+  if (arg->mode == PER_THREAD)
+    aml_pool_destroy(pool);
+  return NULL;
+}
+
+static double run(bench_mode_t mode, int threads, size_t allocs, size_t size) {
+  aml_pool_t *shared = NULL;
+  if (mode == CONCURRENT)
+    shared = aml_pool_init_concurrent(1024 * 1024);
+  else if (mode == MUTEX)
+    shared = aml_pool_init(1024 * 1024);
+
+  pthread_mutex_t mutex;
+  pthread_mutex_init(&mutex, NULL);
+  pthread_barrier_t barrier;
+  pthread_barrier_init(&barrier, NULL, threads + 1);
+
+  pthread_t *tids = (pthread_t *)malloc(sizeof(pthread_t) * threads);
+  bench_arg_t *args = (bench_arg_t *)calloc(threads, sizeof(bench_arg_t));
+  for (int t = 0; t < threads; t++) {
+    args[t].mode = mode;
+    args[t].shared = shared;
+    args[t].mutex = &mutex;
+    args[t].barrier = &barrier;
+    args[t].allocs = allocs;
+    args[t].size = size;
+    pthread_create(&tids[t], NULL, worker, &args[t]);
+  }
+
+  pthread_barrier_wait(&barrier);
+  double start = now_sec();
+  pthread_barrier_wait(&barrier);
+  double elapsed = now_sec() - start;
+
+  for (int t = 0; t < threads; t++)
+    pthread_join(tids[t], NULL);
+
+  free(args);
+  free(tids);
+  pthread_barrier_destroy(&barrier);
+  pthread_mutex_destroy(&mutex);
+  if (shared)
+    aml_pool_destroy(shared);
+
+  return (double)(allocs * threads) / elapsed;
+}
+
+int main(int argc, char **argv) {
+  long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  int max_threads = argc > 1 ? atoi(argv[1]) : (ncpu > 0 ? (int)ncpu : 4);
+  size_t allocs = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000000;
+  size_t size = argc > 3 ? strtoul(argv[3], NULL, 10) : 32;
+  if (max_threads < 1)
+    max_threads = 1;
+
+  printf("%zu allocations of %zu bytes per thread (Mallocs/sec)\n", allocs, size);
+  printf("%8s %14s %14s %14s\n", "threads", mode_names[PER_THREAD],
+         mode_names[CONCURRENT], mode_names[MUTEX]);
+  for (int threads = 1; threads <= max_threads; threads *= 2) {
+    printf("%8d", threads);
+    for (int mode = PER_THREAD; mode <= MUTEX; mode++)
+      printf(" %14.2f", run((bench_mode_t)mode, threads, allocs, size) / 1e6);
+    printf("\n");
+    if (threads < max_threads && threads * 2 > max_threads)
+      threads = max_threads / 2;
+  }
+  return 0;
+}
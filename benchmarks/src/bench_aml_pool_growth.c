@@ -0,0 +1,192 @@
+// SPDX-FileCopyrightText: 2019–2026 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai
+// SPDX-License-Identifier: Apache-2.0
+//
+// Maintainer: Andy Curtis <contactandyc@gmail.com>
+
+/*
+  Replays allocation streams against pools with different growth policies and
+  reports, per policy, the number of blocks the pool ended up with, the bytes
+  the pool holds beyond what was requested (wasted tails, the unused end of
+  the last block, alignment, and block headers), and allocations/sec.
+
+    fixed-4k     - aml_pool_set_growth_fixed(4 KB)
+    fixed-256k   - aml_pool_set_growth_fixed(256 KB)
+    geometric    - aml_pool_set_growth_geometric(16 MB)
+    callback     - aml_pool_set_growth_callback, a block of four times the
+                   request or an eighth of the footprint, whichever is larger
+
+  Synthetic streams are always run.  Recorded streams can be given as files
+  with one allocation size per line.
+
+  usage: bench_aml_pool_growth [stream_file ...]
+*/
+
+#include "a-memory-library/aml_pool.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef struct {
+  const char *name;
+  size_t *sizes;
+  size_t num_sizes;
+} stream_t;
+
+typedef enum { FIXED_4K, FIXED_256K, GEOMETRIC, CALLBACK, NUM_POLICIES } policy_t;
+
+static const char *policy_names[] = {"fixed-4k", "fixed-256k", "geometric",
+                                     "callback"};
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t rng_state = 0x2545f4914f6cdd1dULL;
+
+static uint64_t rng_next(void) {
+  uint64_t x = rng_state;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  rng_state = x;
+  return x;
+}
+
+static size_t growth_cb(void *arg, size_t used, size_t len) {
+  (void)arg;
+  size_t r = len * 4;
+  if (r < used / 8)
+    r = used / 8;
+  return r;
+}
+
+static aml_pool_t *pool_for(policy_t policy) {
+  aml_pool_t *pool = aml_pool_init(4096);
+  if (policy == FIXED_4K)
+    aml_pool_set_growth_fixed(pool, 4096);
+  else if (policy == FIXED_256K)
+    aml_pool_set_growth_fixed(pool, 256 * 1024);
+  else if (policy == GEOMETRIC)
+    aml_pool_set_growth_geometric(pool, 16 * 1024 * 1024);
+  else
+    aml_pool_set_growth_callback(pool, growth_cb, NULL);
+  return pool;
+}
+
+static void run(stream_t *stream, policy_t policy) {
+  size_t requested = 0;
+  for (size_t i = 0; i < stream->num_sizes; i++)
+    requested += stream->sizes[i];
+
+  /* one pass for the shape of the pool */
+  aml_pool_t *pool = pool_for(policy);
+  for (size_t i = 0; i < stream->num_sizes; i++)
+    ((char *)aml_pool_alloc(pool, stream->sizes[i]))[0] = 0;
+  size_t blocks = aml_pool_blocks(pool);
+  size_t used = aml_pool_used(pool);
+  aml_pool_destroy(pool);
+
+  /* repeat the stream for throughput, including pool setup and teardown */
+  size_t reps = 1 + 20000000 / (stream->num_sizes + 1);
+  double start = now_sec();
+  for (size_t r = 0; r < reps; r++) {
+    pool = pool_for(policy);
+    for (size_t i = 0; i < stream->num_sizes; i++)
+      ((char *)aml_pool_alloc(pool, stream->sizes[i]))[0] = 0;
+    aml_pool_destroy(pool);
+  }
+  double elapsed = now_sec() - start;
+
+  printf("%-16s %-11s %8zu %14zu %8.1f%% %12.2f\n", stream->name,
+         policy_names[policy], blocks, used - requested,
+         100.0 * (double)(used - requested) / (double)used,
+         (double)(reps * stream->num_sizes) / elapsed / 1e6);
+}
+
+/* many small allocations, 16 to 256 bytes */
+static void small_stream(stream_t *s, size_t n) {
+  s->name = "small";
+  s->num_sizes = n;
+  s->sizes = (size_t *)malloc(n * sizeof(size_t));
+  for (size_t i = 0; i < n; i++)
+    s->sizes[i] = 16 + rng_next() % 241;
+}
+
+/* mostly small with an occasional allocation of 64 KB to 1 MB */
+static void mixed_stream(stream_t *s, size_t n) {
+  s->name = "mixed";
+  s->num_sizes = n;
+  s->sizes = (size_t *)malloc(n * sizeof(size_t));
+  for (size_t i = 0; i < n; i++) {
+    if (rng_next() % 1000 == 0)
+      s->sizes[i] = 65536 + rng_next() % (1024 * 1024 - 65536);
+    else
+      s->sizes[i] = 16 + rng_next() % 113;
+  }
+}
+
+/* an array that doubles as it is appended to, interleaved with small items */
+static void doubling_stream(stream_t *s, size_t n) {
+  s->name = "doubling";
+  s->num_sizes = n;
+  s->sizes = (size_t *)malloc(n * sizeof(size_t));
+  size_t array = 64;
+  for (size_t i = 0; i < n; i++) {
+    if (i % 64 == 63) {
+      s->sizes[i] = array;
+      if (array < 8 * 1024 * 1024)
+        array *= 2;
+    } else
+      s->sizes[i] = 24 + rng_next() % 40;
+  }
+}
+
+static bool load_stream(stream_t *s, const char *filename) {
+  FILE *in = fopen(filename, "r");
+  if (!in)
+    return false;
+  size_t cap = 1024;
+  s->name = filename;
+  s->num_sizes = 0;
+  s->sizes = (size_t *)malloc(cap * sizeof(size_t));
+  unsigned long long v;
+  while (fscanf(in, "%llu", &v) == 1) {
+    if (v == 0)
+      continue;
+    if (s->num_sizes == cap) {
+      cap *= 2;
+      s->sizes = (size_t *)realloc(s->sizes, cap * sizeof(size_t));
+    }
+    s->sizes[s->num_sizes++] = (size_t)v;
+  }
+  fclose(in);
+  return s->num_sizes > 0;
+}
+
+int main(int argc, char **argv) {
+  stream_t streams[64];
+  size_t num_streams = 0;
+  small_stream(&streams[num_streams++], 100000);
+  mixed_stream(&streams[num_streams++], 100000);
+  doubling_stream(&streams[num_streams++], 1024);
+  for (int i = 1; i < argc && num_streams < 64; i++) {
+    if (load_stream(&streams[num_streams], argv[i]))
+      num_streams++;
+    else
+      fprintf(stderr, "skipping %s\n", argv[i]);
+  }
+
+  printf("%-16s %-11s %8s %14s %9s %12s\n", "stream", "policy", "blocks",
+         "overhead(B)", "overhead", "Mallocs/sec");
+  for (size_t s = 0; s < num_streams; s++) {
+    for (int policy = 0; policy < NUM_POLICIES; policy++)
+      run(&streams[s], (policy_t)policy);
+    free(streams[s].sizes);
+  }
+  return 0;
+}
@@ -0,0 +1,138 @@
+// SPDX-FileCopyrightText: 2019–2026 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai
+// SPDX-License-Identifier: Apache-2.0
+//
+// Maintainer: Andy Curtis <contactandyc@gmail.com>
+
+/*
+  Fills a pool with fixed size records, links them into a single random cycle,
+  and then chases the links.  Every step lands on an unrelated page, so the
+  run is dominated by TLB misses unless the pool is backed by huge pages.
+
+    malloc     - aml_pool_init
+    hugepages  - aml_pool_init_hugepages
+
+  dTLB load misses are read with perf_event_open and reported as n/a when
+  the counter isn't available (for example when perf_event_paranoid is too
+  high or inside some containers).
+
+  usage: bench_aml_pool_hugepages [pool_mb] [steps] [record_size]
+*/
+
+#include "a-memory-library/aml_pool.h"
+
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct record_s {
+  struct record_s *next;
+} record_t;
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int dtlb_open(void) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HW_CACHE;
+  attr.size = sizeof(attr);
+  attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t rng_next(void) {
+  uint64_t x = rng_state;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  rng_state = x;
+  return x;
+}
+
+static void run(const char *name, bool hugepages, size_t pool_mb, size_t steps,
+                size_t record_size) {
+  size_t block = 64 * 1024 * 1024;
+  aml_pool_t *pool =
+      hugepages ? aml_pool_init_hugepages(block) : aml_pool_init(block);
+
+  size_t n = (pool_mb * 1024 * 1024) / record_size;
+  record_t **records = (record_t **)malloc(n * sizeof(record_t *));
+  if (!records)
+    abort();
+
+  double start = now_sec();
+  for (size_t i = 0; i < n; i++)
+    records[i] = (record_t *)aml_pool_alloc(pool, record_size);
+  double fill = now_sec() - start;
+
+  /* shuffle and link the records into one cycle */
+  for (size_t i = n - 1; i > 0; i--) {
+    size_t j = rng_next() % (i + 1);
+    record_t *t = records[i];
+    records[i] = records[j];
+    records[j] = t;
+  }
+  for (size_t i = 0; i < n; i++)
+    records[i]->next = records[(i + 1) % n];
+  record_t *r = records[0];
+  free(records);
+
+  int fd = dtlb_open();
+  if (fd >= 0) {
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+  start = now_sec();
+  for (size_t i = 0; i < steps; i++)
+    r = r->next;
+  double elapsed = now_sec() - start;
+  uint64_t misses = 0;
+  if (fd >= 0) {
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd, &misses, sizeof(misses)) != sizeof(misses))
+      misses = 0;
+    close(fd);
+  }
+
+  static const char *pages[] = {"malloc", "hugetlb", "thp", "mmap"};
+  printf("%-10s %-8s %10.2f %12.2f %10.1f", name, pages[aml_pool_pages(pool)],
+         fill, steps / elapsed / 1e6, elapsed * 1e9 / steps);
+  if (fd >= 0)
+    printf(" %14.3f", (double)misses / steps);
+  else
+    printf(" %14s", "n/a");
+  printf("   (%p)\n", (void *)r);
+  aml_pool_destroy(pool);
+}
+
+int main(int argc, char **argv) {
+  size_t pool_mb = argc > 1 ? strtoul(argv[1], NULL, 10) : 4096;
+  size_t steps = argc > 2 ? strtoul(argv[2], NULL, 10) : 20000000;
+  size_t record_size = argc > 3 ? strtoul(argv[3], NULL, 10) : 256;
+  if (record_size < sizeof(record_t))
+    record_size = sizeof(record_t);
+
+  printf("%zu MB pool of %zu byte records, %zu random steps\n", pool_mb,
+         record_size, steps);
+  printf("%-10s %-8s %10s %12s %10s %14s\n", "pool", "pages", "fill(s)",
+         "Msteps/sec", "ns/step", "dTLB miss/step");
+  run("malloc", false, pool_mb, steps, record_size);
+  run("hugepages", true, pool_mb, steps, record_size);
+  return 0;
+}
@@ -0,0 +1,244 @@
+// SPDX-FileCopyrightText: 2019–2026 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai
+// SPDX-License-Identifier: Apache-2.0
+//
+// Maintainer: Andy Curtis <contactandyc@gmail.com>
+
+/*
+  Compares aml_pool_map_t with the chained hash table that is usually built on
+  a pool (an aml_pool_zalloc'd bucket array of node lists), inserting string
+  and integer keys and then looking each of them up in random order.
+
+    chained  - power of two buckets, nodes from aml_pool_alloc, doubled at a
+               load factor of 1
+    map      - aml_pool_map_str_* / aml_pool_map_int_*
+
+  Once a table is much larger than the caches, string lookups are bound by
+  the miss on the key (the map's slots point at their keys, where a chain's
+  bucket points at its first node), while integer keys sit in the map's
+  slots.
+
+  usage: bench_aml_pool_map [keys] [lookups]
+*/
+
+#include "a-memory-library/aml_pool.h"
+#include "a-memory-library/aml_pool_map.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct node_s {
+  struct node_s *next;
+  uint64_t hash;
+  const char *key;
+  size_t len;
+  void *value;
+} node_t;
+
+typedef struct {
+  aml_pool_t *pool;
+  node_t **buckets;
+  size_t mask;
+  size_t size;
+} chained_t;
+
+typedef struct int_node_s {
+  struct int_node_s *next;
+  uint64_t key;
+  void *value;
+} int_node_t;
+
+typedef struct {
+  aml_pool_t *pool;
+  int_node_t **buckets;
+  size_t mask;
+  size_t size;
+} int_chained_t;
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t hash_key(const char *key, size_t len) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < len; i++)
+    h = (h ^ (unsigned char)key[i]) * 0x100000001b3ULL;
+  return h;
+}
+
+static void chained_insert(chained_t *t, const char *key, size_t len,
+                           void *value) {
+  uint64_t hash = hash_key(key, len);
+  for (node_t *n = t->buckets[hash & t->mask]; n; n = n->next)
+    if (n->hash == hash && n->len == len && !memcmp(n->key, key, len))
+      return;
+  if (t->size > t->mask) {
+    size_t capacity = (t->mask + 1) * 2;
+    node_t **buckets =
+        (node_t **)aml_pool_zalloc(t->pool, sizeof(node_t *) * capacity);
+    for (size_t i = 0; i <= t->mask; i++) {
+      node_t *n = t->buckets[i];
+      while (n) {
+        node_t *next = n->next;
+        n->next = buckets[n->hash & (capacity - 1)];
+        buckets[n->hash & (capacity - 1)] = n;
+        n = next;
+      }
+    }
+    t->buckets = buckets;
+    t->mask = capacity - 1;
+  }
+  node_t *n = (node_t *)aml_pool_alloc(t->pool, sizeof(node_t));
+  n->hash = hash;
+  n->key = (const char *)aml_pool_udup(t->pool, key, len);
+  n->len = len;
+  n->value = value;
+  n->next = t->buckets[hash & t->mask];
+  t->buckets[hash & t->mask] = n;
+  t->size++;
+}
+
+static void *chained_find(chained_t *t, const char *key, size_t len) {
+  uint64_t hash = hash_key(key, len);
+  for (node_t *n = t->buckets[hash & t->mask]; n; n = n->next)
+    if (n->hash == hash && n->len == len && !memcmp(n->key, key, len))
+      return n->value;
+  return NULL;
+}
+
+static inline uint64_t hash_int(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return h;
+}
+
+static void int_chained_insert(int_chained_t *t, uint64_t key, void *value) {
+  uint64_t hash = hash_int(key);
+  for (int_node_t *n = t->buckets[hash & t->mask]; n; n = n->next)
+    if (n->key == key)
+      return;
+  if (t->size > t->mask) {
+    size_t capacity = (t->mask + 1) * 2;
+    int_node_t **buckets =
+        (int_node_t **)aml_pool_zalloc(t->pool, sizeof(int_node_t *) * capacity);
+    for (size_t i = 0; i <= t->mask; i++) {
+      int_node_t *n = t->buckets[i];
+      while (n) {
+        int_node_t *next = n->next;
+        size_t b = hash_int(n->key) & (capacity - 1);
+        n->next = buckets[b];
+        buckets[b] = n;
+        n = next;
+      }
+    }
+    t->buckets = buckets;
+    t->mask = capacity - 1;
+  }
+  int_node_t *n = (int_node_t *)aml_pool_alloc(t->pool, sizeof(int_node_t));
+  n->key = key;
+  n->value = value;
+  n->next = t->buckets[hash & t->mask];
+  t->buckets[hash & t->mask] = n;
+  t->size++;
+}
+
+static void *int_chained_find(int_chained_t *t, uint64_t key) {
+  for (int_node_t *n = t->buckets[hash_int(key) & t->mask]; n; n = n->next)
+    if (n->key == key)
+      return n->value;
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  size_t num_keys = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+  size_t lookups = argc > 2 ? strtoul(argv[2], NULL, 10) : 4000000;
+  if (num_keys < 1)
+    num_keys = 1;
+
+  aml_pool_t *keys_pool = aml_pool_init(1024 * 1024);
+  char **keys = (char **)aml_pool_alloc(keys_pool, sizeof(char *) * num_keys);
+  size_t *lens = (size_t *)aml_pool_alloc(keys_pool, sizeof(size_t) * num_keys);
+  for (size_t i = 0; i < num_keys; i++) {
+    keys[i] = aml_pool_strdupf(keys_pool, "user:%zu:session", i * 7919);
+    lens[i] = strlen(keys[i]);
+  }
+  size_t *order = (size_t *)aml_pool_alloc(keys_pool, sizeof(size_t) * lookups);
+  uint64_t x = 0x2545f4914f6cdd1dULL;
+  for (size_t i = 0; i < lookups; i++) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    order[i] = x % num_keys;
+  }
+  size_t checksum = 0;
+
+  printf("%zu keys, %zu lookups (Mops/sec)\n", num_keys, lookups);
+  printf("%10s %10s %10s\n", "", "insert", "find");
+
+  aml_pool_t *pool = aml_pool_init(1024 * 1024);
+  chained_t t = {pool, NULL, 15, 0};
+  t.buckets = (node_t **)aml_pool_zalloc(pool, sizeof(node_t *) * 16);
+  double start = now_sec();
+  for (size_t i = 0; i < num_keys; i++)
+    chained_insert(&t, keys[i], lens[i], keys[i]);
+  double insert = now_sec() - start;
+  start = now_sec();
+  for (size_t i = 0; i < lookups; i++)
+    checksum += (size_t)chained_find(&t, keys[order[i]], lens[order[i]]);
+  double find = now_sec() - start;
+  printf("%10s %10.2f %10.2f\n", "str-chain", num_keys / insert / 1e6,
+         lookups / find / 1e6);
+  aml_pool_destroy(pool);
+
+  pool = aml_pool_init(1024 * 1024);
+  aml_pool_map_t *m = aml_pool_map_str_init(pool, 0);
+  start = now_sec();
+  for (size_t i = 0; i < num_keys; i++)
+    *aml_pool_map_str_insert(m, keys[i], lens[i], NULL) = keys[i];
+  insert = now_sec() - start;
+  start = now_sec();
+  for (size_t i = 0; i < lookups; i++)
+    checksum += (size_t)*aml_pool_map_str_find(m, keys[order[i]], lens[order[i]]);
+  find = now_sec() - start;
+  printf("%10s %10.2f %10.2f\n", "str-map", num_keys / insert / 1e6,
+         lookups / find / 1e6);
+  aml_pool_destroy(pool);
+
+  pool = aml_pool_init(1024 * 1024);
+  int_chained_t it = {pool, NULL, 15, 0};
+  it.buckets = (int_node_t **)aml_pool_zalloc(pool, sizeof(int_node_t *) * 16);
+  start = now_sec();
+  for (size_t i = 0; i < num_keys; i++)
+    int_chained_insert(&it, i * 7919, keys[i]);
+  insert = now_sec() - start;
+  start = now_sec();
+  for (size_t i = 0; i < lookups; i++)
+    checksum += (size_t)int_chained_find(&it, order[i] * 7919);
+  find = now_sec() - start;
+  printf("%10s %10.2f %10.2f\n", "int-chain", num_keys / insert / 1e6,
+         lookups / find / 1e6);
+  aml_pool_destroy(pool);
+
+  pool = aml_pool_init(1024 * 1024);
+  m = aml_pool_map_int_init(pool, 0);
+  start = now_sec();
+  for (size_t i = 0; i < num_keys; i++)
+    *aml_pool_map_int_insert(m, i * 7919, NULL) = keys[i];
+  insert = now_sec() - start;
+  start = now_sec();
+  for (size_t i = 0; i < lookups; i++)
+    checksum += (size_t)*aml_pool_map_int_find(m, order[i] * 7919);
+  find = now_sec() - start;
+  printf("%10s %10.2f %10.2f\n", "int-map", num_keys / insert / 1e6,
+         lookups / find / 1e6);
+  aml_pool_destroy(pool);
+
+  aml_pool_destroy(keys_pool);
+  return checksum == 0;
+}
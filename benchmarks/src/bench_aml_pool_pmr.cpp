@@ -0,0 +1,88 @@
+// SPDX-FileCopyrightText: 2019–2026 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai
+// SPDX-License-Identifier: Apache-2.0
+//
+// Maintainer: Andy Curtis <contactandyc@gmail.com>
+
+/*
+  Simulates requests which build a std::pmr::vector, a std::pmr::unordered_map
+  of std::pmr::string, and a few temporary strings, and then throw everything
+  away, and reports requests/sec for each memory resource.
+
+    new-delete  - std::pmr::new_delete_resource
+    monotonic   - std::pmr::monotonic_buffer_resource over a 64 KB buffer,
+                  release() after each request
+    aml-pool    - aml::pool_resource over a 64 KB aml_pool_t, aml_pool_clear
+                  after each request
+
+  usage: bench_aml_pool_pmr [requests] [entries]
+*/
+
+#include "a-memory-library/aml_pool.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <memory_resource>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+static double now_sec() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t request(std::pmr::memory_resource *mr, size_t entries) {
+  std::pmr::vector<int> ids(mr);
+  std::pmr::unordered_map<int, std::pmr::string> names(mr);
+  char key[64];
+  for (size_t i = 0; i < entries; i++) {
+    ids.push_back((int)i);
+    snprintf(key, sizeof(key), "request-entry-with-a-longer-name-%zu", i);
+    names.emplace((int)i, std::pmr::string(key, mr));
+  }
+  size_t sum = 0;
+  for (size_t i = 0; i < entries; i += 8) {
+    /* a temporary built and dropped at the top of the resource */
+    std::pmr::string tmp(names[(int)i], mr);
+    tmp += "/suffix";
+    sum += tmp.size() + (size_t)ids[i];
+  }
+  return sum;
+}
+
+int main(int argc, char **argv) {
+  size_t requests = argc > 1 ? strtoul(argv[1], NULL, 10) : 20000;
+  size_t entries = argc > 2 ? strtoul(argv[2], NULL, 10) : 100;
+  size_t checksum = 0;
+
+  printf("%zu requests of %zu entries (requests/sec)\n", requests, entries);
+
+  double start = now_sec();
+  for (size_t i = 0; i < requests; i++)
+    checksum += request(std::pmr::new_delete_resource(), entries);
+  printf("%12s %14.0f\n", "new-delete", requests / (now_sec() - start));
+
+  static char buffer[64 * 1024];
+  std::pmr::monotonic_buffer_resource monotonic(buffer, sizeof(buffer));
+  start = now_sec();
+  for (size_t i = 0; i < requests; i++) {
+    checksum += request(&monotonic, entries);
+    monotonic.release();
+  }
+  printf("%12s %14.0f\n", "monotonic", requests / (now_sec() - start));
+
+  aml_pool_t *pool = aml_pool_init(64 * 1024);
+  aml::pool_resource resource(pool);
+  start = now_sec();
+  for (size_t i = 0; i < requests; i++) {
+    checksum += request(&resource, entries);
+    aml_pool_clear(pool);
+  }
+  printf("%12s %14.0f\n", "aml-pool", requests / (now_sec() - start));
+  aml_pool_destroy(pool);
+
+  return checksum == 0;
+}
@@ -68,6 +68,20 @@ typedef struct {
   aml_dump_details_cb dump;
 } aml_allocator_dump_t;
 
+/* aml_backing_allocator_t lets objects such as aml_pool_t and aml_buffer_t
+   get their memory from somewhere other than aml_malloc (mmap, a NUMA-local
+   allocator, a shared-memory segment, or a third-party allocator).  alloc and
+   free are required.  free is given the length that was originally requested.
+   realloc is optional and is given both the old and new lengths; it must keep
+   the first old_len bytes.  ctx is passed through to each call.  Objects keep
+   a pointer to the allocator, so it must outlive them. */
+typedef struct {
+  void *(*alloc)(void *ctx, size_t len);
+  void (*free)(void *ctx, void *p, size_t len);
+  void *(*realloc)(void *ctx, void *p, size_t old_len, size_t new_len);
+  void *ctx;
+} aml_backing_allocator_t;
+
 char *_aml_strdupf_d(const char *caller, const char *p, ...);
 char *_aml_strdupf(const char *p, ...);
 char *_aml_strdupvf_d(const char *caller, const char *p, va_list args);
@@ -50,6 +50,13 @@ aml_buffer_t *_aml_buffer_init(size_t size, const char *caller);
 aml_buffer_t *_aml_buffer_init(size_t size);
 #endif
 
+/* like aml_buffer_init, except that the buffer and its data are allocated
+   from allocator, which must outlive the buffer.  Data returned by
+   aml_buffer_detach must be released with allocator->free(ctx, data,
+   length + 1). */
+aml_buffer_t *aml_buffer_init_ex(size_t size,
+                                 const aml_backing_allocator_t *allocator);
+
 /* like above, except allocated with a pool (no need to destroy) */
 static inline aml_buffer_t *aml_buffer_pool_init(aml_pool_t *pool,
                                                size_t initial_size);
@@ -0,0 +1,78 @@
+// SPDX-FileCopyrightText: 2019–2026 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai
+// SPDX-License-Identifier: Apache-2.0
+//
+// Maintainer: Andy Curtis <contactandyc@gmail.com>
+
+/*
+  C++17 bindings for aml_buffer_t.
+
+  aml::buffer owns an aml_buffer_t and destroys it when it goes out of scope.
+  It is move-only and holds just the pointer, so the C calls can be used on
+  get() (or the implicit conversion) for everything it doesn't wrap.
+
+    aml::buffer bh(256);
+    aml_buffer_appendf(bh, "%d", 42);
+    std::string_view sv(bh.data(), bh.length());
+*/
+
+#ifndef _aml_buffer_HPP
+#define _aml_buffer_HPP
+
+#include "a-memory-library/aml_buffer.h"
+
+#include <cstddef>
+#include <utility>
+
+namespace aml {
+
+class buffer {
+public:
+  explicit buffer(std::size_t size = 0) { buffer_ = aml_buffer_init(size); }
+  /* allocated from pool, so destroying it does nothing */
+  buffer(aml_pool_t *pool, std::size_t size)
+      : buffer_(aml_buffer_pool_init(pool, size)) {}
+  /* takes ownership of h */
+  explicit buffer(aml_buffer_t *h) noexcept : buffer_(h) {}
+
+  buffer(buffer &&other) noexcept
+      : buffer_(std::exchange(other.buffer_, nullptr)) {}
+  buffer &operator=(buffer &&other) noexcept {
+    if (this != &other) {
+      if (buffer_)
+        aml_buffer_destroy(buffer_);
+      buffer_ = std::exchange(other.buffer_, nullptr);
+    }
+    return *this;
+  }
+  buffer(const buffer &) = delete;
+  buffer &operator=(const buffer &) = delete;
+
+  ~buffer() {
+    if (buffer_)
+      aml_buffer_destroy(buffer_);
+  }
+
+  aml_buffer_t *get() const noexcept { return buffer_; }
+  operator aml_buffer_t *() const noexcept { return buffer_; }
+  explicit operator bool() const noexcept { return buffer_ != nullptr; }
+
+  /* gives up ownership without destroying the buffer */
+  aml_buffer_t *release() noexcept { return std::exchange(buffer_, nullptr); }
+
+  char *data() const { return aml_buffer_data(buffer_); }
+  std::size_t length() const { return aml_buffer_length(buffer_); }
+
+  void clear() { aml_buffer_clear(buffer_); }
+  void append(const void *data, std::size_t length) {
+    aml_buffer_append(buffer_, data, length);
+  }
+  void append(const char *s) { aml_buffer_appends(buffer_, s); }
+
+private:
+  aml_buffer_t *buffer_;
+};
+
+} // namespace aml
+
+#endif
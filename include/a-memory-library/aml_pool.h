@@ -62,17 +62,233 @@ aml_pool_t *_aml_pool_init(size_t size, const char *caller);
 aml_pool_t *_aml_pool_init(size_t size);
 #endif
 
+/* aml_pool_init_ex is like aml_pool_init except that the pool itself and all
+   of its blocks are allocated from allocator, which must outlive the pool.
+   The block depot is not used for these pools. */
+aml_pool_t *aml_pool_init_ex(size_t size,
+                             const aml_backing_allocator_t *allocator);
+
+/* flags for aml_pool_init_external */
+typedef enum {
+  /* once mem is exhausted, the pool grows with heap blocks as usual */
+  AML_POOL_EXTERNAL_GROW = 0,
+  /* the pool never adds a block, running out of mem aborts just as running
+     out of memory does */
+  AML_POOL_EXTERNAL_FIXED = 1
+} aml_pool_external_flags_t;
+
+/* aml_pool_init_external creates a pool inside len bytes of caller provided
+   memory (a stack array, a static region, ...), with the pool header at the
+   start (aligned like malloc) and the rest as the first block, so creating,
+   allocating from, clearing and destroying the pool don't touch the heap
+   until the memory runs out.  Growth blocks (AML_POOL_EXTERNAL_GROW) are
+   the size of the first block.  mem must outlive the pool and is never
+   freed by it.  Returns NULL if len is too small to hold the header. */
+aml_pool_t *aml_pool_init_external(void *mem, size_t len, int flags);
+
+/* aml_pool_init_concurrent creates a pool which may be shared by many threads
+   through the aml_pool_concurrent_* allocation functions below.  Allocation
+   reserves space with a compare and swap on the bump pointer and only takes a
+   lock when a block is exhausted and a new one must be added.  Clearing,
+   restoring, and destroying the pool are not thread safe and must only happen
+   once all of the threads are done allocating from it. */
+#ifdef _AML_DEBUG_
+#define aml_pool_init_concurrent(size) _aml_pool_init_concurrent(size, aml_file_line_func("aml_pool"))
+aml_pool_t *_aml_pool_init_concurrent(size_t size, const char *caller);
+#else
+#define aml_pool_init_concurrent(size) _aml_pool_init_concurrent(size)
+aml_pool_t *_aml_pool_init_concurrent(size_t size);
+#endif
+
+/* aml_pool_init_hugepages creates a pool whose blocks are mapped with mmap and
+   backed by 2 MB pages where the system allows it.  MAP_HUGETLB is tried
+   first, then a 2 MB aligned mapping advised with MADV_HUGEPAGE for systems
+   with transparent huge pages, and finally a regular mapping.  Every block
+   (including the first) is rounded up to a multiple of 2 MB, so this is meant
+   for pools that grow to many megabytes and see TLB pressure. */
+#ifdef _AML_DEBUG_
+#define aml_pool_init_hugepages(size) _aml_pool_init_hugepages(size, aml_file_line_func("aml_pool"))
+aml_pool_t *_aml_pool_init_hugepages(size_t size, const char *caller);
+#else
+#define aml_pool_init_hugepages(size) _aml_pool_init_hugepages(size)
+aml_pool_t *_aml_pool_init_hugepages(size_t size);
+#endif
+
+/* guard modes for aml_pool_init_guarded */
+typedef enum {
+  /* a PROT_NONE page follows every block, so running off the end of a block
+     faults.  Only that is caught: an overrun of an allocation that lands in
+     the rest of its block, or in the unused space at the end of the block,
+     goes unnoticed.  Allocation is as fast as in any other pool. */
+  AML_POOL_GUARD_BLOCKS = 1,
+  /* every allocation gets its own pages and ends at a guard page, so writing
+     past any single allocation faults, in the style of Electric Fence.
+     Allocations end exactly at the page, so aml_pool_alloc returns memory
+     aligned to the largest power of two dividing len (all that len bytes of
+     objects need) rather than to sizeof(size_t).  Only an explicit alignment
+     (aalloc) rounds the start down, leaving up to alignment - 1 unguarded bytes
+     after the allocation.  pop never succeeds and realloc_last always copies,
+     so no allocation can be placed against an earlier one.  Each allocation
+     costs at least two pages of address space and a system call. */
+  AML_POOL_GUARD_ALLOCS = 2
+} aml_pool_guard_t;
+
+/* aml_pool_init_guarded creates a pool whose blocks are mapped with mmap and
+   followed by a guard page, for hardened builds that should catch pool
+   overruns without the global lock of the _AML_DEBUG_ build.  Reads and
+   writes past the end of a block (or of every allocation with
+   AML_POOL_GUARD_ALLOCS) raise SIGSEGV.  Underruns and overruns into a
+   neighboring allocation in the same block aren't caught by
+   AML_POOL_GUARD_BLOCKS. */
+#ifdef _AML_DEBUG_
+#define aml_pool_init_guarded(size, mode)                                      \
+  _aml_pool_init_guarded(size, mode, aml_file_line_func("aml_pool"))
+aml_pool_t *_aml_pool_init_guarded(size_t size, aml_pool_guard_t mode,
+                                   const char *caller);
+#else
+#define aml_pool_init_guarded(size, mode) _aml_pool_init_guarded(size, mode)
+aml_pool_t *_aml_pool_init_guarded(size_t size, aml_pool_guard_t mode);
+#endif
+
+/* how the most recent block of a pool was backed */
+typedef enum {
+  AML_POOL_PAGES_MALLOC = 0,  /* aml_malloc (every pool not created with
+                                 aml_pool_init_hugepages) */
+  AML_POOL_PAGES_HUGETLB = 1, /* mmap with MAP_HUGETLB */
+  AML_POOL_PAGES_THP = 2,     /* mmap advised with MADV_HUGEPAGE */
+  AML_POOL_PAGES_MMAP = 3     /* mmap with regular pages */
+} aml_pool_pages_t;
+
+aml_pool_pages_t aml_pool_pages(aml_pool_t *h);
+
+/* NUMA placement for aml_pool_init_numa */
+typedef enum {
+  AML_POOL_NUMA_LOCAL = 0,     /* the node of the thread creating the pool */
+  AML_POOL_NUMA_BIND = 1,      /* the node passed to aml_pool_init_numa */
+  AML_POOL_NUMA_INTERLEAVE = 2 /* pages spread across all online nodes */
+} aml_pool_numa_policy_t;
+
+/* aml_pool_init_numa creates a pool whose blocks are mapped with mmap and
+   placed according to policy with the mbind system call (libnuma isn't
+   needed).  node is only used by AML_POOL_NUMA_BIND.  LOCAL prefers the
+   creating thread's node but allows other nodes when it is full, while BIND
+   does not.  On a machine with a single node (or a kernel without NUMA
+   support) the pool behaves like any other pool. */
+#ifdef _AML_DEBUG_
+#define aml_pool_init_numa(size, policy, node)                                 \
+  _aml_pool_init_numa(size, policy, node, aml_file_line_func("aml_pool"))
+aml_pool_t *_aml_pool_init_numa(size_t size, aml_pool_numa_policy_t policy,
+                                int node, const char *caller);
+#else
+#define aml_pool_init_numa(size, policy, node)                                 \
+  _aml_pool_init_numa(size, policy, node)
+aml_pool_t *_aml_pool_init_numa(size_t size, aml_pool_numa_policy_t policy,
+                                int node);
+#endif
+
+/* aml_pool_numa_node returns the node that a LOCAL or BIND pool places its
+   blocks on, or -1 for interleaved pools and pools without a NUMA policy. */
+int aml_pool_numa_node(aml_pool_t *h);
+
+/* aml_pool_numa_placement counts the resident pages of the pool's blocks by
+   the node they are on.  pages[n] is set for n < num_nodes and the number of
+   resident pages counted is returned.  Pages that haven't been touched yet
+   aren't resident.  0 is returned if the kernel can't report placement.  This
+   works for any pool that isn't a sub-pool, not just NUMA pools. */
+size_t aml_pool_numa_placement(aml_pool_t *h, size_t *pages, size_t num_nodes);
+
 /* aml_pool_pool_init creates a pool from another pool.  This can be useful for
    having a repeated clearing mechanism inside a larger pool.  Ideally, this
    pool should be sized right as the clear function can't free nodes. */
 aml_pool_t *aml_pool_pool_init(aml_pool_t *pool, size_t initial_size);
 
+/* aml_pool_tls_get returns a pool which belongs to the calling thread.  The
+   first call on each thread creates the pool with an initial size of size
+   bytes (later calls ignore size).  The pool is destroyed automatically when
+   the thread exits.  The main thread doesn't run thread exit handlers, so it
+   should call aml_pool_tls_destroy before exiting if the pool was used. */
+static inline aml_pool_t *aml_pool_tls_get(size_t size);
+
+/* aml_pool_tls_clear clears the calling thread's pool, if it has one.  This is
+   meant to be called at request boundaries. */
+static inline void aml_pool_tls_clear(void);
+
+/* aml_pool_tls_destroy destroys the calling thread's pool now, if it has one.
+   A later aml_pool_tls_get on the same thread will create a new pool. */
+void aml_pool_tls_destroy(void);
 
 /* aml_pool_clear will make all of the pool's memory reusable.  If the
   initial block was exceeded and additional blocks were added, those blocks
   will be freed. */
 void aml_pool_clear(aml_pool_t *h);
 
+/* aml_pool_clear_retain is like aml_pool_clear except that the growth blocks
+  are kept instead of freed.  After the clear, growth reuses the kept blocks in
+  the order that they were originally added before asking the system for more
+  memory, so a pool whose workload regularly exceeds the initial block stops
+  calling malloc and free once it reaches a steady state.  aml_pool_clear
+  releases any retained blocks. */
+void aml_pool_clear_retain(aml_pool_t *h);
+
+/* aml_pool_set_retain_limit caps the number of bytes that aml_pool_clear_retain
+  will keep.  Blocks beyond the limit are freed.  The default (0) is no limit. */
+void aml_pool_set_retain_limit(aml_pool_t *h, size_t max_bytes);
+
+/* aml_pool_set_adaptive makes aml_pool_clear and aml_pool_clear_retain record
+  the bytes used by each cycle.  Once `cycles` peaks have been recorded, the
+  first block is re-allocated whenever the 95th percentile of the last `cycles`
+  peaks doesn't fit in it (or is less than half of a block that was already
+  re-allocated), so that later cycles run in a single block.  The memory of the
+  block given to aml_pool_init stays with the pool until it is destroyed, so
+  start with a small size.  Passing 0 turns adaptive sizing off.  Pools created
+  with aml_pool_pool_init record peaks but never re-allocate. */
+void aml_pool_set_adaptive(aml_pool_t *h, size_t cycles);
+
+/* aml_pool_adaptive_size returns the first block size learned by adaptive mode
+  or 0 if not enough cycles have been recorded.  The value can be saved and
+  passed to aml_pool_init at the next startup. */
+size_t aml_pool_adaptive_size(aml_pool_t *h);
+
+typedef struct {
+  /* These counters are only kept when the library and its users are built
+     with _AML_POOL_STATS_ defined (the A_ENABLE_POOL_STATS CMake option).
+     They are cumulative over the life of the pool. */
+  bool counting;
+  /* allocations, including the ones made by strdup, dup, split, etc. */
+  size_t allocs;
+  /* blocks added because a request didn't fit (side blocks included) */
+  size_t grows;
+  /* calls to aml_pool_clear and aml_pool_clear_retain */
+  size_t clears;
+  /* calls to aml_pool_restore */
+  size_t restores;
+  /* bytes skipped to align allocations */
+  size_t align_bytes;
+  /* bytes left unused at the end of blocks when the pool moved on to a new
+     block */
+  size_t wasted_bytes;
+
+  /* These are always filled in. */
+  /* see aml_pool_used and aml_pool_max_used */
+  size_t used;
+  size_t max_used;
+  /* blocks in the pool (see aml_pool_blocks), side blocks, and the bytes
+     held on the retained list */
+  size_t blocks;
+  size_t side_blocks;
+  size_t retained_bytes;
+  /* the node the pool places its blocks on (see aml_pool_numa_node), -1 if
+     it has none.  Where the pages actually landed is left to
+     aml_pool_numa_placement, which asks the kernel about every page and is
+     too slow for a metrics exporter. */
+  int numa_node;
+} aml_pool_stats_t;
+
+/* aml_pool_get_stats fills in stats for h.  It is cheap enough to call from
+   a metrics exporter, but like aml_pool_used it isn't synchronized with
+   threads allocating from a concurrent pool. */
+void aml_pool_get_stats(aml_pool_t *h, aml_pool_stats_t *stats);
+
 /* aml_pool_destroy frees up all memory associated with the pool object */
 void aml_pool_destroy(aml_pool_t *h);
 
@@ -84,6 +300,23 @@ typedef struct aml_pool_marker_s aml_pool_marker_t;
 static inline void aml_pool_save(aml_pool_t *h, aml_pool_marker_t *cp);
 static inline void aml_pool_restore(aml_pool_t *h, aml_pool_marker_t *cp);
 
+/* aml_pool_pop releases p, the len byte allocation on top of the pool, for
+   allocations made and dropped in strict LIFO order.  If everything in the
+   current growth block has been popped and p was the last allocation in the
+   block before it, the pool steps back into that block.  false is returned
+   (and nothing changes) unless p + len is exactly the top of the pool.  The
+   padding that aligned a popped allocation isn't given back, so after
+   popping it, an allocation before it whose length wasn't a multiple of
+   sizeof(size_t) can't be popped.  Side blocks are not popped. */
+static inline bool aml_pool_pop(aml_pool_t *h, void *p, size_t len);
+
+/* aml_pool_set_stack_mode makes aml_pool_restore and aml_pool_pop keep the
+   growth blocks they release (on the same list as aml_pool_clear_retain,
+   subject to aml_pool_set_retain_limit) so that recursion which oscillates
+   around a block boundary reuses blocks instead of calling malloc and free.
+   aml_pool_clear still frees them. */
+void aml_pool_set_stack_mode(aml_pool_t *h, bool enabled);
+
 
 /* aml_pool_set_minimum_growth_size alters the minimum size of growth blocks.
    This is particularly useful if you don't expect the pool's block size to be
@@ -91,6 +324,77 @@ static inline void aml_pool_restore(aml_pool_t *h, aml_pool_marker_t *cp);
    original block size for the new block (effectively doubling memory usage). */
 void aml_pool_set_minimum_growth_size(aml_pool_t *h, size_t size);
 
+/* Growth policies decide the size of each block added by growth.  A block is
+   never smaller than the request that caused it.  Setting one policy replaces
+   the previous one.
+
+   aml_pool_set_growth_fixed makes every growth block size bytes.  This is the
+   default policy with the size set to the initial size of the pool (it is the
+   same as aml_pool_set_minimum_growth_size).
+
+   aml_pool_set_growth_geometric makes each growth block as large as the pool's
+   footprint so far (see aml_pool_used), doubling the pool each time it grows,
+   but never larger than max_block_size or smaller than the fixed size.
+
+   aml_pool_set_growth_callback asks cb for the size of each growth block.  cb
+   receives arg, the pool's footprint (aml_pool_used), and the length of the
+   request which didn't fit.  Passing a NULL cb returns to the fixed policy. */
+typedef size_t (*aml_pool_growth_cb)(void *arg, size_t used, size_t len);
+
+void aml_pool_set_growth_fixed(aml_pool_t *h, size_t size);
+void aml_pool_set_growth_geometric(aml_pool_t *h, size_t max_block_size);
+void aml_pool_set_growth_callback(aml_pool_t *h, aml_pool_growth_cb cb,
+                                  void *arg);
+
+/* aml_pool_set_side_threshold makes requests of at least threshold bytes that
+   don't fit in the current block go into a block of their own instead of
+   replacing the current block.  The remainder of the current block stays
+   usable for the small allocations that follow.  Side blocks are freed by
+   aml_pool_clear, aml_pool_clear_retain, and aml_pool_restore (back to the
+   marker).  The default (0) turns this off. */
+void aml_pool_set_side_threshold(aml_pool_t *h, size_t threshold);
+
+/* aml_pool_compact copies everything allocated from the pool (the used part
+   of each block and the side blocks) into one block, in allocation order,
+   and frees the old blocks along with any retained ones.  The image is left
+   as the pool's only block, so its start (the return value) and length
+   (returned through len) can be written out as-is.  Addresses keep their
+   offset within a 64 byte line, so alignments of up to 64 survive the move.
+
+   The block allocated with the pool can't be freed on its own.  When the
+   live bytes fit in it, the image is built there (what it already holds
+   stays put) and the footprint only shrinks.  Otherwise the image goes in a
+   new block and the initial block stays allocated, idle, until the pool is
+   destroyed or a later compaction fits in it.
+
+   Everything moves, so cb (if not NULL) is called once after the copy with a
+   relocation that maps old addresses to new ones.  The old blocks are still
+   readable while cb runs.  Raw pointers in the image and outside of the pool
+   should be updated with aml_pool_relocate, and self-relative offsets such
+   as aml_relptr_t with aml_pool_relocate_offset.  Markers saved before the
+   compaction are no longer valid.
+
+   If the pool is already a single block which the initial block can't
+   take, nothing moves and cb isn't called.
+   The pool remains usable, allocation continues at the end of the image.
+   Like aml_pool_clear, this must not be called while other threads allocate
+   from a concurrent pool. */
+typedef struct aml_pool_relocation_s aml_pool_relocation_t;
+typedef void (*aml_pool_relocate_cb)(void *arg, const aml_pool_relocation_t *r);
+
+void *aml_pool_compact(aml_pool_t *h, size_t *len, aml_pool_relocate_cb cb,
+                       void *arg);
+
+/* aml_pool_relocate returns where p (an old address, or one past the end of
+   an old allocation) was moved to.  Addresses that weren't in the pool,
+   including NULL, are returned unchanged. */
+void *aml_pool_relocate(const aml_pool_relocation_t *r, const void *p);
+
+/* aml_pool_relocate_offset fixes the self-relative offset at rp (an address
+   in the new image) so that it points at the new location of its old
+   target.  Call it exactly once per offset; 0 (NULL) is left alone. */
+void aml_pool_relocate_offset(const aml_pool_relocation_t *r, int64_t *rp);
+
 /* aml_pool_alloc allocates len uninitialized bytes which are aligned. */
 static inline void *aml_pool_alloc(aml_pool_t *h, size_t len);
 
@@ -99,6 +403,25 @@ static inline void *aml_pool_alloc(aml_pool_t *h, size_t len);
    for this is for SIMD instructions where alignment would be 64. */
 void *aml_pool_aalloc(aml_pool_t *pool, size_t alignment, size_t len);
 
+/* AML_POOL_DEFINE(name, align, block) defines a pool type specialized to a
+   fixed alignment and block size, for hot paths that allocate many objects
+   with the same alignment.  At file scope,
+
+     AML_POOL_DEFINE(vec_pool, 64, 1024 * 1024)
+
+   defines
+
+     typedef aml_pool_t vec_pool_t;
+     vec_pool_t *vec_pool_init(void);  // aml_pool_init(block)
+     void *vec_pool_alloc(vec_pool_t *h, size_t len);
+     void *vec_pool_zalloc(vec_pool_t *h, size_t len);
+
+   The allocators are inline, align is a compile time constant (a power of
+   two, checked statically), and the pool grows in blocks of block bytes.
+   vec_pool_t is an aml_pool_t, so the rest of the aml_pool_* functions
+   (clear, save, destroy, ...) work on it as usual. */
+#define AML_POOL_DEFINE(name, align, block) _AML_POOL_DEFINE(name, align, block)
+
 /* aml_pool_min_max_alloc allocates at least min_len bytes and up to len bytes.
    If the */
 static inline void *aml_pool_min_max_alloc(aml_pool_t *h, size_t *rlen,
@@ -113,6 +436,31 @@ static inline void *aml_pool_zalloc(aml_pool_t *h, size_t len);
 /* aml_pool_alloc allocates len zero'd bytes which are aligned. */
 static inline void *aml_pool_calloc(aml_pool_t *h, size_t num_items, size_t size);
 
+/* aml_pool_alloc_batch allocates count uninitialized objects of size bytes
+   and stores a pointer to each in out.  Every object is aligned like
+   aml_pool_alloc, the objects are laid out back to back, and the pool only
+   checks its capacity once for the objects which fit in the current block
+   and once more (growing a block for the rest) if some don't. */
+void aml_pool_alloc_batch(aml_pool_t *h, size_t count, size_t size,
+                          void **out);
+
+/* aml_pool_alloc_array allocates one aligned, uninitialized array of count
+   objects of size bytes.  The pool aborts if count * size overflows. */
+static inline void *aml_pool_alloc_array(aml_pool_t *h, size_t count,
+                                         size_t size);
+
+/* The aml_pool_concurrent_* functions may be called from many threads at once
+   on a pool created with aml_pool_init_concurrent.  They behave like
+   aml_pool_alloc, aml_pool_ualloc, aml_pool_zalloc, aml_pool_dup, and
+   aml_pool_strdup.  The regular allocation functions must not be mixed with
+   these while the pool is being shared. */
+static inline void *aml_pool_concurrent_alloc(aml_pool_t *h, size_t len);
+static inline void *aml_pool_concurrent_ualloc(aml_pool_t *h, size_t len);
+static inline void *aml_pool_concurrent_zalloc(aml_pool_t *h, size_t len);
+static inline void *aml_pool_concurrent_dup(aml_pool_t *h, const void *data,
+                                            size_t len);
+static inline char *aml_pool_concurrent_strdup(aml_pool_t *h, const char *p);
+
 /* aml_pool_strdup allocates a copy of the string p.  The memory will be
   unaligned.  If you need the memory to be aligned, consider using aml_pool_dup
   like char *s = aml_pool_dup(pool, p, strlen(p)+1); */
@@ -132,6 +480,15 @@ static inline char *aml_pool_strndup(aml_pool_t *h, const char *p, size_t length
 /* aml_pool_dup allocates a copy of the data.  The memory will be aligned. */
 static inline void *aml_pool_dup(aml_pool_t *h, const void *data, size_t len);
 
+/* aml_pool_realloc_last resizes p, which was allocated from the pool with
+   old_len bytes, to new_len bytes.  If p is still the most recent allocation
+   and the block has room, it is extended (or shrunk) in place and p is
+   returned.  Otherwise, new aligned memory is allocated and the first
+   min(old_len, new_len) bytes are copied to it (the old copy stays in the
+   pool until it is cleared).  A NULL p is the same as aml_pool_alloc. */
+static inline void *aml_pool_realloc_last(aml_pool_t *h, void *p,
+                                          size_t old_len, size_t new_len);
+
 /* aml_pool_dup allocates a copy of the data.  The memory will be unaligned. */
 static inline void *aml_pool_udup(aml_pool_t *h, const void *data, size_t len);
 
@@ -148,6 +505,10 @@ size_t aml_pool_used(aml_pool_t *h);
 /* aml_pool_max_used returns the maximum usage */
 size_t aml_pool_max_used(aml_pool_t *h);
 
+/* aml_pool_blocks returns the number of blocks currently linked into the pool
+   (including the first block, excluding retained and side blocks). */
+size_t aml_pool_blocks(aml_pool_t *h);
+
 /* split a string into N pieces using delimiter.  The array that is returned
    will always be valid with a NULL string at the end if p is NULL. num_splits
    can be NULL if the number of returning pieces is not desired. */
@@ -235,6 +596,35 @@ char **aml_pool_split_csv(aml_pool_t *pool, size_t *num_splits, const char *s);
    the parsed strings are allocated in the pool. */
 char **aml_pool_split_tsv(aml_pool_t *pool, size_t *num_splits, const char *s);
 
+/* aml_pool_intern returns the pool's canonical, zero terminated copy of the
+   len bytes at s.  Equal strings get the same pointer, so interned strings
+   can be compared with ==.  The copies are kept apart from the pool's other
+   allocations (aml_pool_restore and aml_pool_pop don't release them) and
+   last until aml_pool_clear, aml_pool_clear_retain, or aml_pool_destroy.
+   Interned strings must not be modified.
+
+   The copies are kept in a second pool which gets its memory the same way
+   as this one (the same backing allocator, NUMA policy, page kind, guard
+   mode, or parent pool).  A pool made from external memory with
+   AML_POOL_EXTERNAL_FIXED can't grow, so interning into one aborts rather
+   than fall back to malloc. */
+const char *aml_pool_intern(aml_pool_t *pool, const char *s, size_t len);
+
+/* aml_pool_interned returns the number of distinct strings interned since
+   the pool was last cleared */
+size_t aml_pool_interned(aml_pool_t *pool);
+
+/* aml_pool_split_intern, aml_pool_split_csv_intern, and
+   aml_pool_split_tsv_intern are like aml_pool_split, aml_pool_split_csv, and
+   aml_pool_split_tsv, except that each token is interned.  Only the array is
+   allocated from the pool; repeated tokens cost nothing beyond it. */
+const char **aml_pool_split_intern(aml_pool_t *pool, size_t *num_splits,
+                                   char delim, const char *s);
+const char **aml_pool_split_csv_intern(aml_pool_t *pool, size_t *num_splits,
+                                       const char *s);
+const char **aml_pool_split_tsv_intern(aml_pool_t *pool, size_t *num_splits,
+                                       const char *s);
+
 /* aml_pool_join_csv takes an array of strings and joins them into a single
    comma-separated line.  The resulting string is allocated in the pool and
    is null-terminated.  It does not add a trailing newline. */
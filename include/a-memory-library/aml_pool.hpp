@@ -0,0 +1,218 @@
+// SPDX-FileCopyrightText: 2019–2026 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai
+// SPDX-License-Identifier: Apache-2.0
+//
+// Maintainer: Andy Curtis <contactandyc@gmail.com>
+
+/*
+  C++17 bindings for aml_pool_t.
+
+  aml::pool_resource is a std::pmr::memory_resource which allocates from an
+  existing pool, so that std::pmr containers share the pool with C code and
+  are released along with everything else by a single aml_pool_clear (or
+  aml_pool_restore).  The resource doesn't own the pool.
+
+    aml_pool_t *pool = aml_pool_init(64 * 1024);
+    aml::pool_resource resource(pool);
+    std::pmr::vector<int> v(&resource);
+    std::pmr::unordered_map<int, std::pmr::string> m(&resource);
+    ...
+    aml_pool_clear(pool);  // the containers must be gone (or never touched
+                           // again) by now
+
+  Deallocation only gives memory back when it is the most recent allocation
+  from the pool (the LIFO case, such as a temporary string built and dropped
+  at the top of the pool), otherwise it does nothing.  Containers whose
+  destructors don't run before the pool is cleared never call it at all.
+
+  aml::pool_allocator<T> does the same for the allocator parameter of the
+  standard containers (std::vector<int, aml::pool_allocator<int>>), without
+  the virtual calls.
+
+  aml::pool owns a pool and destroys it, and aml::pool_scope saves the pool
+  on construction and restores it on destruction.  Both are move-only and
+  hold nothing beyond what the C calls need, so they cost no allocations of
+  their own.
+
+    aml::pool pool(4096);
+    {
+      aml::pool_scope scope(pool);
+      std::vector<int, aml::pool_allocator<int>> v(pool);
+      ...
+    } // v is gone and the pool is back where the scope found it
+*/
+
+#ifndef _aml_pool_HPP
+#define _aml_pool_HPP
+
+#include "a-memory-library/aml_pool.h"
+
+#include <cstddef>
+#include <limits>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace aml {
+
+namespace detail {
+
+inline void *pool_allocate(aml_pool_t *pool, std::size_t bytes,
+                           std::size_t alignment) {
+  /* aml_pool_alloc already aligns to sizeof(size_t), except in a pool that
+     guards every allocation, where it only aligns to what bytes divides by */
+  if (alignment <= sizeof(size_t) &&
+      (pool->guard != AML_POOL_GUARD_ALLOCS || bytes % alignment == 0))
+    return aml_pool_alloc(pool, bytes);
+  return aml_pool_aalloc(pool, alignment, bytes);
+}
+
+/* only the top of the pool can be given back */
+inline void pool_deallocate(aml_pool_t *pool, void *p, std::size_t bytes) {
+  if (static_cast<char *>(p) + bytes == pool->curp)
+    aml_pool_pop(pool, p, bytes);
+}
+
+} // namespace detail
+
+class pool_resource : public std::pmr::memory_resource {
+public:
+  explicit pool_resource(aml_pool_t *pool) noexcept : pool_(pool) {}
+
+  pool_resource(const pool_resource &) = delete;
+  pool_resource &operator=(const pool_resource &) = delete;
+
+  aml_pool_t *pool() const noexcept { return pool_; }
+
+protected:
+  void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+    return detail::pool_allocate(pool_, bytes, alignment);
+  }
+
+  void do_deallocate(void *p, std::size_t bytes, std::size_t) override {
+    detail::pool_deallocate(pool_, p, bytes);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const
+      noexcept override {
+    if (this == &other)
+      return true;
+    const pool_resource *r = dynamic_cast<const pool_resource *>(&other);
+    return r && r->pool_ == pool_;
+  }
+
+private:
+  aml_pool_t *pool_;
+};
+
+/* Owns a pool, destroying it when it goes out of scope. */
+class pool {
+public:
+  explicit pool(std::size_t size) : pool_(aml_pool_init(size)) {}
+  /* takes ownership of p */
+  explicit pool(aml_pool_t *p) noexcept : pool_(p) {}
+
+  pool(pool &&other) noexcept : pool_(std::exchange(other.pool_, nullptr)) {}
+  pool &operator=(pool &&other) noexcept {
+    if (this != &other) {
+      if (pool_)
+        aml_pool_destroy(pool_);
+      pool_ = std::exchange(other.pool_, nullptr);
+    }
+    return *this;
+  }
+  pool(const pool &) = delete;
+  pool &operator=(const pool &) = delete;
+
+  ~pool() {
+    if (pool_)
+      aml_pool_destroy(pool_);
+  }
+
+  aml_pool_t *get() const noexcept { return pool_; }
+  operator aml_pool_t *() const noexcept { return pool_; }
+  explicit operator bool() const noexcept { return pool_ != nullptr; }
+
+  /* gives up ownership without destroying the pool */
+  aml_pool_t *release() noexcept { return std::exchange(pool_, nullptr); }
+
+  void clear() { aml_pool_clear(pool_); }
+
+private:
+  aml_pool_t *pool_;
+};
+
+/* Saves the pool on construction and restores it on destruction, releasing
+   everything allocated in between.  A scope that has been moved from doesn't
+   restore. */
+class pool_scope {
+public:
+  explicit pool_scope(aml_pool_t *pool) noexcept : pool_(pool) {
+    aml_pool_save(pool_, &marker_);
+  }
+
+  pool_scope(pool_scope &&other) noexcept
+      : pool_(std::exchange(other.pool_, nullptr)), marker_(other.marker_) {}
+  pool_scope &operator=(pool_scope &&) = delete;
+  pool_scope(const pool_scope &) = delete;
+  pool_scope &operator=(const pool_scope &) = delete;
+
+  ~pool_scope() {
+    if (pool_)
+      aml_pool_restore(pool_, &marker_);
+  }
+
+private:
+  aml_pool_t *pool_;
+  aml_pool_marker_t marker_;
+};
+
+/* A standard allocator over a pool.  Copies (including rebound ones) share
+   the pool, and the pool must outlive every container using it. */
+template <class T> class pool_allocator {
+public:
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+  using is_always_equal = std::false_type;
+
+  pool_allocator(aml_pool_t *pool) noexcept : pool_(pool) {}
+  pool_allocator(const aml::pool &pool) noexcept : pool_(pool.get()) {}
+  template <class U>
+  pool_allocator(const pool_allocator<U> &other) noexcept
+      : pool_(other.pool()) {}
+
+  T *allocate(std::size_t n) {
+    if (n > std::numeric_limits<std::size_t>::max() / sizeof(T))
+      throw std::bad_array_new_length();
+    return static_cast<T *>(
+        detail::pool_allocate(pool_, n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T *p, std::size_t n) noexcept {
+    detail::pool_deallocate(pool_, p, n * sizeof(T));
+  }
+
+  aml_pool_t *pool() const noexcept { return pool_; }
+
+private:
+  aml_pool_t *pool_;
+};
+
+template <class T, class U>
+bool operator==(const pool_allocator<T> &a,
+                const pool_allocator<U> &b) noexcept {
+  return a.pool() == b.pool();
+}
+
+template <class T, class U>
+bool operator!=(const pool_allocator<T> &a,
+                const pool_allocator<U> &b) noexcept {
+  return a.pool() != b.pool();
+}
+
+} // namespace aml
+
+#endif
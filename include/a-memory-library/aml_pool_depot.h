@@ -0,0 +1,79 @@
+// SPDX-FileCopyrightText: 2019–2026 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai
+// SPDX-License-Identifier: Apache-2.0
+//
+// Maintainer: Andy Curtis <contactandyc@gmail.com>
+
+/*
+  The depot is a process-wide cache of recycled pool blocks.  When it is
+  enabled, pool growth takes blocks from the depot and aml_pool_clear,
+  aml_pool_restore, and aml_pool_destroy return growth blocks to it instead of
+  calling aml_malloc and aml_free for every block.  Programs that create and
+  clear many short-lived pools stop paying for that churn once the depot has
+  warmed up.
+
+  Blocks are grouped into power of two size classes from 4 KB to 64 MB (a
+  block handed out by the depot may be larger than what was requested, and the
+  pool uses the extra space).  Each thread keeps a small magazine of blocks per
+  class, so most requests never touch shared state.  When a magazine fills up
+  or runs dry, blocks move to or from a lock-free global stack for the class.
+  The total number of bytes held by the depot is capped; blocks returned
+  beyond the cap are freed.
+
+  Pools created with aml_pool_pool_init or aml_pool_init_hugepages don't use
+  the depot, and neither does the first block of a pool (which is allocated
+  along with the pool itself).
+*/
+
+#ifndef _aml_pool_depot_H
+#define _aml_pool_depot_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  /* requests satisfied from a magazine or the global stacks */
+  size_t hits;
+  /* requests that had to allocate a new block */
+  size_t misses;
+  /* blocks freed because the depot was full */
+  size_t overflows;
+  /* bytes currently held by the depot (all threads) */
+  size_t cached_bytes;
+  /* the cap given to aml_pool_depot_enable */
+  size_t max_cached_bytes;
+} aml_pool_depot_stats_t;
+
+/* aml_pool_depot_enable turns the depot on and caps the bytes it may hold.
+   Passing 0 turns it off; blocks already cached stay until
+   aml_pool_depot_trim is called. */
+void aml_pool_depot_enable(size_t max_cached_bytes);
+
+/* aml_pool_depot_stats fills in stats with the current counters */
+void aml_pool_depot_stats(aml_pool_depot_stats_t *stats);
+
+/* aml_pool_depot_trim frees the blocks in the global stacks and in the
+   calling thread's magazines.  Other threads' magazines are flushed to the
+   global stacks when those threads exit. */
+void aml_pool_depot_trim(void);
+
+/* aml_pool_depot_alloc returns a block of at least *len bytes and sets *len
+   to the size of its class.  NULL is returned if the depot is disabled or
+   *len is larger than the largest class, in which case the caller should
+   allocate the block itself.  The block is allocated with aml_malloc. */
+void *aml_pool_depot_alloc(size_t *len);
+
+/* aml_pool_depot_release offers a block allocated with aml_malloc back to the
+   depot.  It returns false if the depot didn't take it (disabled, full, or
+   len isn't exactly the size of a class) and the caller must free it. */
+bool aml_pool_depot_release(void *block, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
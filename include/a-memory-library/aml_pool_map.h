@@ -0,0 +1,96 @@
+// SPDX-FileCopyrightText: 2019–2026 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai
+// SPDX-License-Identifier: Apache-2.0
+//
+// Maintainer: Andy Curtis <contactandyc@gmail.com>
+
+/*
+  aml_pool_map_t is a grow-only hash map which lives entirely in a pool.  It
+  is an open addressing table in the style of a Swiss table: each slot has a
+  control byte which is either empty or holds 7 bits of the key's hash, and a
+  lookup compares a group of 16 control bytes at once (with SSE2 when it is
+  available) before looking at any keys.  Integer keys and their values are
+  stored in a flat slot array; a string map's slots point at entries which
+  hold the key and value together.
+
+  A map either has string keys (any bytes, given with a length) or 64 bit
+  integer keys, and maps them to a void * value.  String keys are copied into
+  the pool on insert and never move, so a string map's value slots stay valid
+  across rehashes.  There is no erase.  When the map fills up (7/8 of its
+  slots), it rehashes into a table twice the size allocated from the same
+  pool; the old table is reclaimed along with the rest of the pool.  The map
+  itself is never destroyed, clear or destroy the pool instead.
+
+    aml_pool_map_t *m = aml_pool_map_str_init(pool, 0);
+    bool inserted;
+    void **v = aml_pool_map_str_insert(m, "key", 3, &inserted);
+    if (inserted)
+      *v = value;
+    ...
+    v = aml_pool_map_str_find(m, "key", 3);  // NULL if missing
+
+  Calling a str function on an integer map (or the other way around) aborts.
+  A map must not be used from more than one thread at a time.
+*/
+
+#ifndef _aml_pool_map_H
+#define _aml_pool_map_H
+
+#include "a-memory-library/aml_pool.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct aml_pool_map_s;
+typedef struct aml_pool_map_s aml_pool_map_t;
+
+/* aml_pool_map_str_init creates a map with string keys, sized to hold at
+   least size_hint entries before it rehashes (0 for the smallest table). */
+aml_pool_map_t *aml_pool_map_str_init(aml_pool_t *pool, size_t size_hint);
+
+/* aml_pool_map_int_init creates a map with uint64_t keys */
+aml_pool_map_t *aml_pool_map_int_init(aml_pool_t *pool, size_t size_hint);
+
+/* aml_pool_map_str_insert returns the value slot for key, adding the key
+   with a NULL value if it isn't in the map yet.  If inserted isn't NULL, it
+   is set to whether the key was added. */
+void **aml_pool_map_str_insert(aml_pool_map_t *m, const char *key, size_t len,
+                               bool *inserted);
+
+/* aml_pool_map_str_find returns the value slot for key, or NULL */
+void **aml_pool_map_str_find(const aml_pool_map_t *m, const char *key,
+                             size_t len);
+
+/* aml_pool_map_str_key returns the map's zero terminated copy of the key for
+   a value slot returned by a string map.  The copy lives as long as the
+   map's pool. */
+const char *aml_pool_map_str_key(void **value);
+
+/* the integer versions of insert and find.  The value slots of an integer
+   map are only valid until the next insert. */
+void **aml_pool_map_int_insert(aml_pool_map_t *m, uint64_t key,
+                               bool *inserted);
+void **aml_pool_map_int_find(const aml_pool_map_t *m, uint64_t key);
+
+/* aml_pool_map_size returns the number of keys in the map */
+size_t aml_pool_map_size(const aml_pool_map_t *m);
+
+/* aml_pool_map_str_next and aml_pool_map_int_next iterate over the map in
+   no particular order.  Start with *pos = 0; each call stores the next entry
+   and returns true, or returns false at the end.  The map must not be
+   inserted into while iterating.  The string keys are zero terminated. */
+bool aml_pool_map_str_next(const aml_pool_map_t *m, size_t *pos,
+                           const char **key, size_t *len, void **value);
+bool aml_pool_map_int_next(const aml_pool_map_t *m, size_t *pos,
+                           uint64_t *key, void **value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
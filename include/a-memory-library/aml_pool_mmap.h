@@ -0,0 +1,91 @@
+// SPDX-FileCopyrightText: 2019–2026 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai
+// SPDX-License-Identifier: Apache-2.0
+//
+// Maintainer: Andy Curtis <contactandyc@gmail.com>
+
+/*
+  A file-backed pool allocates everything from a single shared mapping of a
+  file, so a structure built in it is already in its on-disk form.  Once the
+  builder calls aml_pool_mmap_sync, any process can map the file read-only
+  with aml_pool_mmap_open and use the structure in place, without parsing or
+  copying it.  Startup is then bounded by page faults rather than by the work
+  it took to build the structure.
+
+  The file is mapped at a different address in every process, so pointers
+  between objects in the file must be stored as aml_relptr_t (an offset from
+  the relptr itself) rather than as raw pointers.  The root of the structure
+  is recorded in the file header with aml_pool_mmap_set_root.
+
+  The pool returned by aml_pool_mmap_init is an ordinary aml_pool_t and works
+  with all of the aml_pool_* functions.  It is a single block that covers the
+  whole reservation; it never grows, and allocating past the reservation
+  aborts just as running out of memory does.  The reservation only costs
+  address space (the file is sparse until it is written to), so it can be
+  generous.
+
+  The layout of the file is the native one for the machine that built it.
+*/
+
+#ifndef _aml_pool_mmap_H
+#define _aml_pool_mmap_H
+
+#include "a-memory-library/aml_pool.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* aml_pool_mmap_init creates (or truncates) the file at path, reserves
+   reserve bytes for it, and returns a pool which allocates from the mapping.
+   NULL is returned if the file can't be created or mapped. */
+aml_pool_t *aml_pool_mmap_init(const char *path, size_t reserve);
+
+/* aml_pool_mmap_set_root records p (which must have been allocated from h)
+   as the root of the structure in the file header. */
+void aml_pool_mmap_set_root(aml_pool_t *h, const void *p);
+
+/* aml_pool_mmap_sync records how much of the file is in use and flushes the
+   mapping to the file.  Readers see the file as of the last sync, and
+   aml_pool_destroy truncates the file to the length recorded by it. */
+bool aml_pool_mmap_sync(aml_pool_t *h);
+
+/* aml_pool_mmap_offset returns the offset of p from the start of the file */
+size_t aml_pool_mmap_offset(aml_pool_t *h, const void *p);
+
+typedef struct {
+  /* the start of the read-only mapping */
+  const void *base;
+  /* the length recorded by the last aml_pool_mmap_sync */
+  size_t length;
+  /* the root recorded with aml_pool_mmap_set_root or NULL */
+  const void *root;
+} aml_pool_mmap_view_t;
+
+/* aml_pool_mmap_open maps a file written by a file-backed pool read-only.
+   It returns false if the file can't be opened or wasn't written by
+   aml_pool_mmap_init and synced. */
+bool aml_pool_mmap_open(aml_pool_mmap_view_t *view, const char *path);
+
+/* aml_pool_mmap_close unmaps a view opened with aml_pool_mmap_open */
+void aml_pool_mmap_close(aml_pool_mmap_view_t *view);
+
+/* A relptr holds the distance from itself to what it points at, so it stays
+   valid wherever the file is mapped.  0 is reserved for NULL (a relptr can't
+   point at itself). */
+typedef int64_t aml_relptr_t;
+
+static inline void aml_relptr_set(aml_relptr_t *rp, const void *p);
+static inline void *aml_relptr_get(const aml_relptr_t *rp);
+
+#include "a-memory-library/impl/aml_pool_mmap.h"
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
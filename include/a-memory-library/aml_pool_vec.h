@@ -0,0 +1,94 @@
+// SPDX-FileCopyrightText: 2019–2026 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai
+// SPDX-License-Identifier: Apache-2.0
+//
+// Maintainer: Andy Curtis <contactandyc@gmail.com>
+
+/*
+  aml_pool_vec_t is a growable array of fixed size elements which lives in a
+  pool.  It is meant for building up a result whose length isn't known ahead
+  of time (the fields of a line, the matches of a search) without a counting
+  pass.
+
+  When the array is the last allocation in the pool's current block, growing
+  it just moves the end of the block forward and nothing is copied.  When
+  something else has been allocated from the pool since, or the block is
+  full, the capacity doubles into a new array and the old one is left to the
+  pool.  So a vector that is built without other allocations from the same
+  pool in between grows in place until its block runs out.
+
+    aml_pool_vec_t v;
+    aml_pool_vec_init(&v, pool, sizeof(int), 0);
+    for (...)
+      aml_pool_vec_push_value(&v, int, x);
+    aml_pool_vec_shrink_to_fit(&v);
+    int *a = (int *)v.data;  // v.size elements
+
+  Elements are aligned to sizeof(size_t), like aml_pool_alloc.  Pointers into
+  the vector are invalidated by anything that grows it.  There is no
+  destroy; the memory goes away with the pool.  A vector must not be used
+  from more than one thread at a time.
+*/
+
+#ifndef _aml_pool_vec_H
+#define _aml_pool_vec_H
+
+#include "a-memory-library/aml_pool.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  aml_pool_t *pool;
+  char *data;
+  size_t size;
+  size_t capacity;
+  size_t elem_size;
+} aml_pool_vec_t;
+
+/* aml_pool_vec_init sets up an empty vector of elem_size byte elements with
+   room for capacity of them (0 allocates nothing until the first push). */
+void aml_pool_vec_init(aml_pool_vec_t *v, aml_pool_t *pool, size_t elem_size,
+                       size_t capacity);
+
+/* aml_pool_vec_push adds one uninitialized element and returns it */
+static inline void *aml_pool_vec_push(aml_pool_vec_t *v);
+
+/* aml_pool_vec_push_n adds n uninitialized elements and returns the first */
+static inline void *aml_pool_vec_push_n(aml_pool_vec_t *v, size_t n);
+
+/* aml_pool_vec_extend copies n elements from items onto the end and returns
+   the first copy.  items must not point into the vector itself. */
+static inline void *aml_pool_vec_extend(aml_pool_vec_t *v, const void *items,
+                                        size_t n);
+
+/* aml_pool_vec_clear empties the vector, keeping its capacity */
+static inline void aml_pool_vec_clear(aml_pool_vec_t *v);
+
+/* aml_pool_vec_reserve makes room for at least capacity elements */
+void aml_pool_vec_reserve(aml_pool_vec_t *v, size_t capacity);
+
+/* aml_pool_vec_shrink_to_fit gives the unused capacity back to the pool if
+   the vector is still the last allocation, otherwise it does nothing.  It
+   returns the data. */
+void *aml_pool_vec_shrink_to_fit(aml_pool_vec_t *v);
+
+/* typed access to element i */
+#define aml_pool_vec_at(v, type, i) (((type *)(v)->data)[i])
+
+/* pushes value as a type */
+#define aml_pool_vec_push_value(v, type, value)                               \
+  (*(type *)aml_pool_vec_push(v) = (value))
+
+#include "a-memory-library/impl/aml_pool_vec.h"
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
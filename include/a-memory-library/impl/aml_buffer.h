@@ -6,6 +6,8 @@
 
 #include <stdlib.h>
 
+#include "a-memory-library/impl/aml_probe.h"
+
 struct aml_buffer_s {
 #ifdef _AML_DEBUG_
   aml_allocator_dump_t dump;
@@ -16,8 +18,28 @@ struct aml_buffer_s {
   size_t length;
   size_t size;
   aml_pool_t *pool;
+  /* if set, memory comes from here instead of aml_malloc */
+  const aml_backing_allocator_t *backing;
 };
 
+/* heap memory for buffers that aren't pool backed goes through these */
+static inline void *_aml_buffer_malloc(aml_buffer_t *h, size_t len) {
+  if (h->backing) {
+    void *r = h->backing->alloc(h->backing->ctx, len);
+    if (!r)
+      abort();
+    return r;
+  }
+  return aml_malloc(len);
+}
+
+static inline void _aml_buffer_free(aml_buffer_t *h, void *p, size_t len) {
+  if (h->backing)
+    h->backing->free(h->backing->ctx, p, len);
+  else
+    aml_free(p);
+}
+
 static inline aml_buffer_t *aml_buffer_pool_init(aml_pool_t *pool,
                                                size_t initial_size) {
   aml_buffer_t *h = (aml_buffer_t *)aml_pool_zalloc(pool, sizeof(aml_buffer_t));
@@ -37,9 +59,12 @@ void aml_buffer_destroy(aml_buffer_t *h) {
     uintptr_t pe = pb + sizeof(*h);
     uintptr_t pd = (uintptr_t)h->data;
     if (!(pd >= pb && pd < pe)) {
-      aml_free(h->data);
+      _aml_buffer_free(h, h->data, h->size + 1);
     }
-    aml_free(h);
+    if (h->backing)
+      h->backing->free(h->backing->ctx, h, sizeof(*h));
+    else
+      aml_free(h);
   }
 }
 
@@ -75,9 +100,21 @@ char *aml_buffer_detach(aml_buffer_t *h, size_t *length_out) {
             /* No real heap buffer yet: allocate a minimal heap buffer the
                caller can safely free. Length is 0, so 1 byte is fine. */
             size_t alloc = (len > 0) ? len : 1;
-            ret = (char *)aml_malloc(alloc);
+            ret = (char *)_aml_buffer_malloc(h, alloc);
             /* Nothing to copy (no user data was stored); just NUL-terminate. */
             if (alloc > 0) ret[0] = '\0';
+        } else if (h->backing && h->size != len) {
+            /* the caller frees with length + 1, so hand back exactly that */
+            const aml_backing_allocator_t *a = h->backing;
+            if (a->realloc)
+                ret = (char *)a->realloc(a->ctx, h->data, h->size + 1, len + 1);
+            else {
+                ret = (char *)_aml_buffer_malloc(h, len + 1);
+                memcpy(ret, h->data, len + 1);
+                _aml_buffer_free(h, h->data, h->size + 1);
+            }
+            if (!ret)
+                abort();
         } else {
             /* Transfer ownership of the existing heap allocation. */
             ret = h->data;
@@ -105,8 +142,8 @@ static inline void aml_buffer_clear(aml_buffer_t *h) {
 static inline void aml_buffer_reset(aml_buffer_t *h, size_t max_size) {
     if (h->size > max_size) {
         if (!h->pool) {
-            aml_free(h->data);
-            h->data = (char *)aml_malloc(max_size + 1);
+            _aml_buffer_free(h, h->data, h->size + 1);
+            h->data = (char *)_aml_buffer_malloc(h, max_size + 1);
             h->size = max_size;
         } // do nothing if pool
     }
@@ -126,14 +163,25 @@ static inline char *aml_buffer_end(aml_buffer_t *h) {
 
 static inline void _aml_buffer_grow(aml_buffer_t *h, size_t length) {
   size_t len = (length + 50) + (h->size >> 3);
+  AML_PROBE3(buffer_grow, h, h->size, len);
   // if(len > 100*1024*1024)
   //  printf("aml_buffer_t: %p(%p): growing to %zu\n", (void*)h, (void*)h->pool, (size_t)len);
-  if (!h->pool) {
-    char *data = (char *)aml_malloc(len + 1);
+  if (h->backing && h->backing->realloc && h->size) {
+    char *data = (char *)h->backing->realloc(h->backing->ctx, h->data,
+                                             h->size + 1, len + 1);
+    if (!data)
+      abort();
+    h->data = data;
+  } else if (!h->pool) {
+    char *data = (char *)_aml_buffer_malloc(h, len + 1);
     memcpy(data, h->data, h->length + 1);
     if (h->size)
-      aml_free(h->data);
+      _aml_buffer_free(h, h->data, h->size + 1);
     h->data = data;
+  } else if (h->size) {
+    /* extends in place while the data is the pool's latest allocation */
+    h->data = (char *)aml_pool_realloc_last(h->pool, h->data, h->size + 1,
+                                            len + 1);
   } else {
     char *data = (char *)aml_pool_alloc(h->pool, len + 1);
     if(h->length)
@@ -251,8 +299,8 @@ static inline void _aml_buffer_alloc(aml_buffer_t *h, size_t length) {
   size_t len = (length + 50) + (h->size >> 3);
   if (!h->pool) {
     if (h->size)
-      aml_free(h->data);
-    h->data = (char *)aml_malloc(len + 1);
+      _aml_buffer_free(h, h->data, h->size + 1);
+    h->data = (char *)_aml_buffer_malloc(h, len + 1);
   } else
     h->data = (char *)aml_pool_alloc(h->pool, len + 1);
   h->size = len;
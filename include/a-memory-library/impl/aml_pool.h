@@ -6,6 +6,8 @@
 
 /* IMPLEMENTATION FOLLOWS - API is above this line */
 
+#include "a-memory-library/impl/aml_probe.h"
+
 /* Because this object is called very frequently, some of the functionality is
   inlined. Inlining the structure can be helpful for other objects, particularly
   if they want to be able to take advantage of the remaining memory in a block
@@ -13,11 +15,47 @@
 
 /* used internally */
 void *_aml_pool_alloc_grow(aml_pool_t *h, size_t len);
+void *_aml_pool_aalloc_grow(aml_pool_t *h, size_t alignment, size_t len);
+
+struct aml_pool_node_s;
+void *_aml_pool_concurrent_alloc_grow(aml_pool_t *h,
+                                      struct aml_pool_node_s *current,
+                                      size_t len);
+void _aml_pool_release_blocks(aml_pool_t *h, struct aml_pool_node_s *prev);
+bool _aml_pool_pop_block(aml_pool_t *h, char *p, size_t len);
+void _aml_pool_free_side_blocks(aml_pool_t *h, struct aml_pool_node_s *side);
 
 // #ifndef _AML_USE_MALLOC_
 // #define _AML_USE_MALLOC_
 // #endif
 
+#ifdef _AML_POOL_STATS_
+struct aml_pool_counters_s {
+  size_t allocs;
+  size_t grows;
+  size_t clears;
+  size_t restores;
+  size_t align_bytes;
+  size_t wasted_bytes;
+};
+
+/* counters are plain adds on the single threaded paths and relaxed atomic
+   adds where concurrent pools may be involved */
+#define _aml_pool_count(h, counter, n) ((h)->counters.counter += (n))
+#define _aml_pool_count_atomic(h, counter, n)                                 \
+  __atomic_fetch_add(&(h)->counters.counter, (n), __ATOMIC_RELAXED)
+#else
+#define _aml_pool_count(h, counter, n) ((void)0)
+#define _aml_pool_count_atomic(h, counter, n) ((void)0)
+#endif
+
+/* for code generated by macros, which can't use #ifdef */
+#ifdef _AML_DEBUG_
+#define _aml_pool_cur_size_add(h, n) ((h)->cur_size += (n))
+#else
+#define _aml_pool_cur_size_add(h, n) ((void)0)
+#endif
+
 typedef struct aml_pool_node_s {
   /* The aml_pool_node_s includes a block of memory just after it.  endp
     points to the end of that block of memory.
@@ -26,6 +64,11 @@ typedef struct aml_pool_node_s {
 
   /* this will be NULL if it is the first block. */
   struct aml_pool_node_s *prev;
+
+  /* where allocation stopped when the pool moved on to a newer block (only
+    meaningful for blocks other than the current one, used by
+    aml_pool_compact) */
+  char *usedp;
 } aml_pool_node_t;
 
 struct aml_pool_s {
@@ -53,6 +96,17 @@ struct aml_pool_s {
     later be modified. */
   size_t minimum_growth_size;
 
+  /* if growth_cb is set, it picks the size of growth blocks.  Otherwise, if
+    growth_max is set, growth is geometric up to growth_max. */
+  aml_pool_growth_cb growth_cb;
+  void *growth_arg;
+  size_t growth_max;
+
+  /* requests of at least side_threshold bytes which don't fit in the current
+    block get their own block, linked through prev from side (0 means off) */
+  size_t side_threshold;
+  aml_pool_node_t *side;
+
   /* the size doesn't consider the bytes that are used in the current block */
   size_t size;
 
@@ -64,6 +118,57 @@ struct aml_pool_s {
 
   /* if set, memory is allocated from this pool */
   aml_pool_t *pool;
+
+  /* growth blocks kept by aml_pool_clear_retain, linked through prev in the
+    order that they will be reused.  retained_bytes is not included in used. */
+  aml_pool_node_t *retained;
+  size_t retained_bytes;
+
+  /* the most bytes that aml_pool_clear_retain will keep (0 means no limit) */
+  size_t retain_limit;
+
+  /* if set, restore and pop retain blocks instead of freeing them */
+  bool stack_mode;
+
+  /* if set, the pool was created with aml_pool_init_concurrent and block
+    growth is serialized through this lock. */
+  struct aml_pool_lock_s *lock;
+
+  /* if set, aml_pool_clear resizes the first block from the recent peaks
+    (see aml_pool_set_adaptive). */
+  struct aml_pool_adaptive_s *adaptive;
+
+  /* if set, the pool and its blocks come from here (see aml_pool_init_ex) */
+  const aml_backing_allocator_t *backing;
+
+  /* if set, the header and first block are in memory given to
+    aml_pool_init_external, which the pool doesn't free */
+  bool external;
+
+  /* if set, the pool never adds a block (AML_POOL_EXTERNAL_FIXED) */
+  bool fixed;
+
+  /* an aml_pool_guard_t if the pool was created with aml_pool_init_guarded,
+    blocks are then mapped with a PROT_NONE page after them */
+  int guard;
+
+  /* if set, blocks are mapped with mmap and bound with mbind */
+  struct aml_pool_numa_s *numa;
+
+  /* an aml_pool_pages_t, blocks are mapped with mmap if this is not
+    AML_POOL_PAGES_MALLOC */
+  int pages;
+
+  /* strings interned with aml_pool_intern are kept in intern_pool (created
+    on first use) so that restoring or popping this pool can't release them,
+    and are looked up through intern. */
+  aml_pool_t *intern_pool;
+  struct aml_pool_map_s *intern;
+
+#ifdef _AML_POOL_STATS_
+  /* see aml_pool_get_stats */
+  struct aml_pool_counters_s counters;
+#endif
 };
 
 static inline void *aml_pool_ualloc(aml_pool_t *h, size_t len) {
@@ -73,9 +178,11 @@ static inline void *aml_pool_ualloc(aml_pool_t *h, size_t len) {
 #ifdef _AML_DEBUG_
     h->cur_size += len;
 #endif
+    _aml_pool_count(h, allocs, 1);
     return r;
   }
-  return _aml_pool_alloc_grow(h, len);
+  /* unaligned, so that a guarded pool can end it right at the guard page */
+  return _aml_pool_aalloc_grow(h, 1, len);
 }
 
 static inline void *aml_pool_min_max_alloc(aml_pool_t *h, size_t *rlen,
@@ -84,6 +191,8 @@ static inline void *aml_pool_min_max_alloc(aml_pool_t *h, size_t *rlen,
       h->curp + ((sizeof(size_t) - ((size_t)(h->curp) & (sizeof(size_t) - 1))) &
                  (sizeof(size_t) - 1));
   if (r + len < h->current->endp) {
+    _aml_pool_count(h, allocs, 1);
+    _aml_pool_count(h, align_bytes, r - h->curp);
     h->curp = r + len;
 #ifdef _AML_DEBUG_
     h->cur_size += len;
@@ -92,6 +201,8 @@ static inline void *aml_pool_min_max_alloc(aml_pool_t *h, size_t *rlen,
     return r;
   }
   if (r + min_len < h->current->endp) {
+    _aml_pool_count(h, allocs, 1);
+    _aml_pool_count(h, align_bytes, r - h->curp);
     len = (h->current->endp - r) - 1;
     h->curp = r + len;
 #ifdef _AML_DEBUG_
@@ -114,11 +225,91 @@ static inline void *aml_pool_alloc(aml_pool_t *h, size_t len) {
 #ifdef _AML_DEBUG_
     h->cur_size += len;
 #endif
+    _aml_pool_count(h, allocs, 1);
+    _aml_pool_count(h, align_bytes, to_add);
     return r;
   }
   return _aml_pool_alloc_grow(h, len);
 }
 
+static inline void *aml_pool_realloc_last(aml_pool_t *h, void *p,
+                                          size_t old_len, size_t new_len) {
+  char *r = (char *)p;
+  if (!r)
+    return aml_pool_alloc(h, new_len);
+  /* a pool guarding every allocation must never bump allocate into the
+     block of an earlier one */
+  if (r + old_len == h->curp && r + new_len < h->current->endp &&
+      h->guard != AML_POOL_GUARD_ALLOCS) {
+    h->curp = r + new_len;
+#ifdef _AML_DEBUG_
+    h->cur_size += new_len;
+    h->cur_size -= old_len;
+#endif
+    return r;
+  }
+  char *d = (char *)aml_pool_alloc(h, new_len);
+  memcpy(d, r, old_len < new_len ? old_len : new_len);
+  return d;
+}
+
+/* The concurrent fast path reserves space by swinging curp forward with a
+  compare and swap.  current and curp are read separately, so a reader may
+  observe one of them from before a grow and the other from after.  Blocks are
+  never freed while the pool is shared, so a curp that falls inside current
+  can only belong to current, otherwise the pair is reread. */
+static inline void *_aml_pool_concurrent_reserve(aml_pool_t *h, size_t len,
+                                                 size_t mask) {
+  for (;;) {
+    aml_pool_node_t *current = __atomic_load_n(&h->current, __ATOMIC_ACQUIRE);
+    char *curp = __atomic_load_n(&h->curp, __ATOMIC_ACQUIRE);
+    if (curp < (char *)(current + 1) || curp > current->endp)
+      continue;
+    char *r = curp + ((mask + 1 - ((size_t)curp & mask)) & mask);
+    if (r + len >= current->endp)
+      return _aml_pool_concurrent_alloc_grow(h, current, len);
+    if (__atomic_compare_exchange_n(&h->curp, &curp, r + len, true,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+#ifdef _AML_DEBUG_
+      __atomic_fetch_add(&h->cur_size, len, __ATOMIC_RELAXED);
+#endif
+      _aml_pool_count_atomic(h, allocs, 1);
+      _aml_pool_count_atomic(h, align_bytes, (size_t)(r - curp));
+      return r;
+    }
+  }
+}
+
+static inline void *aml_pool_concurrent_alloc(aml_pool_t *h, size_t len) {
+  return _aml_pool_concurrent_reserve(h, len, sizeof(size_t) - 1);
+}
+
+static inline void *aml_pool_concurrent_ualloc(aml_pool_t *h, size_t len) {
+  return _aml_pool_concurrent_reserve(h, len, 0);
+}
+
+static inline void *aml_pool_concurrent_zalloc(aml_pool_t *h, size_t len) {
+  void *dest = aml_pool_concurrent_alloc(h, len);
+  if (len)
+    memset(dest, 0, len);
+  return dest;
+}
+
+static inline void *aml_pool_concurrent_dup(aml_pool_t *h, const void *data,
+                                            size_t len) {
+  void *dest = aml_pool_concurrent_alloc(h, len);
+  if (len)
+    memcpy(dest, data, len);
+  return dest;
+}
+
+static inline char *aml_pool_concurrent_strdup(aml_pool_t *h, const char *p) {
+  size_t len = strlen(p);
+  char *dest = (char *)aml_pool_concurrent_ualloc(h, len + 1);
+  memcpy(dest, p, len + 1);
+  return dest;
+}
+
 static inline void *aml_pool_zalloc(aml_pool_t *h, size_t len) {
   /* calloc will simply call the pool_alloc function and then zero the memory.
    */
@@ -134,6 +325,47 @@ static inline void *aml_pool_calloc(aml_pool_t *h, size_t num_items, size_t size
   return aml_pool_zalloc(h, num_items*size);
 }
 
+static inline void *aml_pool_alloc_array(aml_pool_t *h, size_t count,
+                                         size_t size) {
+  size_t len;
+  if (__builtin_mul_overflow(count, size, &len))
+    abort();
+  return aml_pool_alloc(h, len);
+}
+
+#ifdef __cplusplus
+#define _AML_STATIC_ASSERT(cond, msg) static_assert(cond, msg)
+#else
+#define _AML_STATIC_ASSERT(cond, msg) _Static_assert(cond, msg)
+#endif
+
+/* align and block are constants, so the padding is a fixed mask and a len
+   that is known not to fit in a block skips the fast path entirely */
+#define _AML_POOL_DEFINE(name, align, block)                                  \
+  _AML_STATIC_ASSERT((align) > 0 && ((align) & ((align) - 1)) == 0,           \
+                     #name ": alignment must be a power of two");             \
+  _AML_STATIC_ASSERT((block) > 0, #name ": block size must not be zero");    \
+  typedef aml_pool_t name##_t;                                                \
+  static inline name##_t *name##_init(void) { return aml_pool_init(block); }  \
+  static inline void *name##_alloc(name##_t *h, size_t len) {                 \
+    char *r = (char *)(((uintptr_t)h->curp + ((align) - 1)) &                 \
+                       ~(uintptr_t)((align) - 1));                            \
+    if ((!__builtin_constant_p(len) || len < (size_t)(block)) &&              \
+        r + len < h->current->endp) {                                         \
+      _aml_pool_count(h, allocs, 1);                                          \
+      _aml_pool_count(h, align_bytes, r - h->curp);                           \
+      _aml_pool_cur_size_add(h, len);                                         \
+      h->curp = r + len;                                                      \
+      return r;                                                               \
+    }                                                                         \
+    return _aml_pool_aalloc_grow(h, (align), len);                            \
+  }                                                                           \
+  static inline void *name##_zalloc(name##_t *h, size_t len) {                \
+    void *r = name##_alloc(h, len);                                           \
+    memset(r, 0, len);                                                        \
+    return r;                                                                 \
+  }
+
 static inline void *aml_pool_udup(aml_pool_t *h, const void *data, size_t len) {
   /* dup will simply allocate enough bytes to hold the duplicated data,
     copy the data, and return the newly allocated memory which contains a copy
@@ -184,8 +416,26 @@ static inline char *aml_pool_strdupf(aml_pool_t *pool, const char *fmt, ...) {
 
 char **_aml_pool_split(aml_pool_t *h, size_t *num_splits, char delim, char *s);
 
+/* the calling thread's pool, see aml_pool_tls_get */
+extern __thread aml_pool_t *_aml_pool_tls;
+
+aml_pool_t *_aml_pool_tls_init(size_t size);
+
+static inline aml_pool_t *aml_pool_tls_get(size_t size) {
+  aml_pool_t *h = _aml_pool_tls;
+  if (h)
+    return h;
+  return _aml_pool_tls_init(size);
+}
+
+static inline void aml_pool_tls_clear(void) {
+  if (_aml_pool_tls)
+    aml_pool_clear(_aml_pool_tls);
+}
+
 struct aml_pool_marker_s {
   aml_pool_node_t *prev;
+  aml_pool_node_t *side;
   char *curp;
   size_t size;
   size_t used;
@@ -196,6 +446,7 @@ struct aml_pool_marker_s {
 
 static inline void aml_pool_save(aml_pool_t *h, aml_pool_marker_t *m) {
   m->prev = h->current->prev;
+  m->side = h->side;
   m->curp = h->curp;
   m->size = h->size;
   m->used = h->used;
@@ -204,23 +455,32 @@ static inline void aml_pool_save(aml_pool_t *h, aml_pool_marker_t *m) {
 #endif
 }
 
-static inline void aml_pool_restore(aml_pool_t *h, aml_pool_marker_t *m) {
-  /* remove the extra blocks (the ones where prev != NULL) */
-  aml_pool_node_t *prev = h->current->prev;
-  while (prev != m->prev) {
-    if(!h->pool) {
-#ifdef _AML_USE_MALLOC_
-      free(h->current);
-#else
-      aml_free(h->current);
+static inline bool aml_pool_pop(aml_pool_t *h, void *p, size_t len) {
+  char *r = (char *)p;
+  /* see aml_pool_realloc_last */
+  if (h->guard == AML_POOL_GUARD_ALLOCS)
+    return false;
+  if (r >= (char *)(h->current + 1) && r + len == h->curp) {
+#ifdef _AML_DEBUG_
+    h->cur_size -= (h->curp - r);
 #endif
-    }
-    h->current = prev;
-    prev = prev->prev;
+    h->curp = r;
+    return true;
   }
+  return _aml_pool_pop_block(h, r, len);
+}
+
+static inline void aml_pool_restore(aml_pool_t *h, aml_pool_marker_t *m) {
+  AML_PROBE3(pool_restore, h, h->used, m->used);
+  /* remove the extra blocks (the ones where prev != NULL) */
+  if (h->current->prev != m->prev)
+    _aml_pool_release_blocks(h, m->prev);
+  if (h->side != m->side)
+    _aml_pool_free_side_blocks(h, m->side);
 
   /* reset to marker */
   h->curp = m->curp;
+  _aml_pool_count(h, restores, 1);
   h->size = m->size;
 
 #ifdef _AML_DEBUG_
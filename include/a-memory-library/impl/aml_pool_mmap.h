@@ -0,0 +1,15 @@
+// SPDX-FileCopyrightText: 2019–2026 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai
+// SPDX-License-Identifier: Apache-2.0
+//
+// Maintainer: Andy Curtis <contactandyc@gmail.com>
+
+/* IMPLEMENTATION FOLLOWS - API is above this line */
+
+static inline void aml_relptr_set(aml_relptr_t *rp, const void *p) {
+  *rp = p ? (aml_relptr_t)((const char *)p - (const char *)rp) : 0;
+}
+
+static inline void *aml_relptr_get(const aml_relptr_t *rp) {
+  return *rp ? (void *)((const char *)rp + *rp) : NULL;
+}
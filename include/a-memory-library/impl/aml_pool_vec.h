@@ -0,0 +1,40 @@
+// SPDX-FileCopyrightText: 2019–2026 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai
+// SPDX-License-Identifier: Apache-2.0
+//
+// Maintainer: Andy Curtis <contactandyc@gmail.com>
+
+#ifndef _aml_pool_vec_IMPL_H
+#define _aml_pool_vec_IMPL_H
+
+/* grows the vector to hold at least min_capacity elements */
+void _aml_pool_vec_grow(aml_pool_vec_t *v, size_t min_capacity);
+
+static inline void *aml_pool_vec_push(aml_pool_vec_t *v) {
+  if (v->size == v->capacity)
+    _aml_pool_vec_grow(v, v->size + 1);
+  return v->data + v->size++ * v->elem_size;
+}
+
+static inline void *aml_pool_vec_push_n(aml_pool_vec_t *v, size_t n) {
+  if (v->capacity - v->size < n) {
+    if (n > (size_t)-1 - v->size)
+      abort();
+    _aml_pool_vec_grow(v, v->size + n);
+  }
+  char *r = v->data + v->size * v->elem_size;
+  v->size += n;
+  return r;
+}
+
+static inline void *aml_pool_vec_extend(aml_pool_vec_t *v, const void *items,
+                                        size_t n) {
+  void *r = aml_pool_vec_push_n(v, n);
+  if (n)
+    memcpy(r, items, n * v->elem_size);
+  return r;
+}
+
+static inline void aml_pool_vec_clear(aml_pool_vec_t *v) { v->size = 0; }
+
+#endif
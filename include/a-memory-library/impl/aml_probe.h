@@ -0,0 +1,59 @@
+// SPDX-FileCopyrightText: 2019–2026 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai
+// SPDX-License-Identifier: Apache-2.0
+//
+// Maintainer: Andy Curtis <contactandyc@gmail.com>
+
+/* Static tracepoints (USDT) on the slow paths of the library.  They are
+   compiled in when _AML_USDT_ is defined (the A_ENABLE_USDT CMake option) and
+   <sys/sdt.h> is available, and compile to nothing otherwise.  A compiled in
+   probe is a single nop until a tracer such as bpftrace or perf attaches to
+   it, but its arguments are still computed, so they are kept to values that
+   are already at hand.  The provider is "aml"; see tools/bpftrace for
+   examples. */
+
+#ifndef _aml_probe_H
+#define _aml_probe_H
+
+#if defined(_AML_USDT_) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define _AML_PROBES_ENABLED
+#endif
+#endif
+
+#ifdef _AML_PROBES_ENABLED
+#define AML_PROBE2(name, a, b) DTRACE_PROBE2(aml, name, a, b)
+#define AML_PROBE3(name, a, b, c) DTRACE_PROBE3(aml, name, a, b, c)
+#define AML_PROBE5(name, a, b, c, d, e) DTRACE_PROBE5(aml, name, a, b, c, d, e)
+#else
+/* the arguments are never evaluated, they are only named so that values
+   computed for a probe don't become unused variables */
+#define AML_PROBE2(name, a, b)                                                \
+  do {                                                                        \
+    if (0) {                                                                  \
+      (void)(a);                                                              \
+      (void)(b);                                                              \
+    }                                                                         \
+  } while (0)
+#define AML_PROBE3(name, a, b, c)                                             \
+  do {                                                                        \
+    if (0) {                                                                  \
+      (void)(a);                                                              \
+      (void)(b);                                                              \
+      (void)(c);                                                              \
+    }                                                                         \
+  } while (0)
+#define AML_PROBE5(name, a, b, c, d, e)                                       \
+  do {                                                                        \
+    if (0) {                                                                  \
+      (void)(a);                                                              \
+      (void)(b);                                                              \
+      (void)(c);                                                              \
+      (void)(d);                                                              \
+      (void)(e);                                                              \
+    }                                                                         \
+  } while (0)
+#endif
+
+#endif
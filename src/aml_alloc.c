@@ -5,6 +5,7 @@
 // Maintainer: Andy Curtis <contactandyc@gmail.com>
 
 #include "a-memory-library/aml_alloc.h"
+#include "a-memory-library/impl/aml_probe.h"
 #include <pthread.h>
 #include <string.h>
 #include <stdint.h>
@@ -209,6 +210,7 @@ void *_aml_malloc_d(const char *caller, size_t len, bool custom) {
   aml_allocator_node_t *n =
       (aml_allocator_node_t *)malloc(sizeof(aml_allocator_node_t) + len);
   if (!n) {
+    AML_PROBE2(alloc_fail, caller, len);
     pthread_mutex_lock(&a->mutex);
     print_node(stderr, caller, len, NULL);
     fprintf(stderr, "malloc failed\n");
@@ -234,6 +236,7 @@ void *_aml_malloc_d(const char *caller, size_t len, bool custom) {
     a->head = n;
   a->tail = n;
   pthread_mutex_unlock(&a->mutex);
+  AML_PROBE3(alloc, caller, n + 1, len);
   return (void *)(n + 1);
 }
 
@@ -455,6 +458,7 @@ static aml_allocator_node_t *get_aml_node(const char *caller, void *p, const cha
   if (n->a == a)
     return n;
 
+  AML_PROBE2(bad_pointer, caller, p);
   pthread_mutex_lock(&a->mutex);
   fprintf(stderr, "Bad pointer passed to %s: %s\n", caller, message);
   pthread_mutex_unlock(&a->mutex);
@@ -520,6 +524,7 @@ void _aml_free_d(const char *caller, void *p) {
   aml_allocator_t *a = global_allocator;
   aml_allocator_node_t *n =
       get_aml_node(caller, p, "aml_free is invalid (double free?)");
+  AML_PROBE2(free, caller, p);
   pthread_mutex_lock(&a->mutex);
   if (n->previous)
     n->previous->next = n->next;
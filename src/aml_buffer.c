@@ -34,6 +34,27 @@ aml_buffer_t *_aml_buffer_init(size_t initial_size) {
   h->length = 0;
   h->size = initial_size;
   h->pool = NULL;
+  h->backing = NULL;
+  return h;
+}
+
+aml_buffer_t *aml_buffer_init_ex(size_t initial_size,
+                                 const aml_backing_allocator_t *allocator) {
+  if (!allocator || !allocator->alloc || !allocator->free)
+    abort();
+  aml_buffer_t *h =
+      (aml_buffer_t *)allocator->alloc(allocator->ctx, sizeof(aml_buffer_t));
+  if (!h)
+    abort();
+  memset(h, 0, sizeof(*h));
+  h->backing = allocator;
+#ifdef _AML_DEBUG_
+  h->initial_size = initial_size;
+#endif
+  h->data = initial_size ? (char *)_aml_buffer_malloc(h, initial_size + 1)
+                         : (char *)(&(h->size));
+  h->data[0] = 0;
+  h->size = initial_size;
   return h;
 }
 
@@ -6,9 +6,48 @@
 
 #include "a-memory-library/aml_alloc.h"
 #include "a-memory-library/aml_pool.h"
+#include "a-memory-library/aml_pool_depot.h"
+#include "a-memory-library/aml_pool_map.h"
+#include "a-memory-library/aml_pool_vec.h"
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <errno.h>
+
+#define AML_POOL_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+struct aml_pool_lock_s {
+  pthread_mutex_t mutex;
+};
+
+/* the memory policy modes from linux/mempolicy.h */
+#define AML_MPOL_PREFERRED 1
+#define AML_MPOL_BIND 2
+#define AML_MPOL_INTERLEAVE 3
+
+#define AML_NUMA_MAX_NODES 1024
+#define AML_NUMA_MASK_BITS (8 * sizeof(unsigned long))
+
+struct aml_pool_numa_s {
+  int node;
+  int mode;
+  /* false on single node machines, blocks are mapped but not bound */
+  bool active;
+  unsigned long mask[AML_NUMA_MAX_NODES / AML_NUMA_MASK_BITS];
+};
+
+/* a ring of the bytes used by the last `cycles` clears */
+struct aml_pool_adaptive_s {
+  size_t cycles;
+  size_t count;
+  size_t pos;
+  size_t learned;
+  /* cycles peaks followed by cycles of scratch space for sorting them */
+  size_t peaks[];
+};
 
 // #ifndef _AML_USE_MALLOC_
 // #define _AML_USE_MALLOC_
@@ -18,7 +57,7 @@ size_t aml_pool_size(aml_pool_t *h) {
   return h->size + (h->current->endp - h->curp);
 }
 
-size_t aml_pool_used(aml_pool_t *h) { return h->used; }
+size_t aml_pool_used(aml_pool_t *h) { return h->used + h->retained_bytes; }
 
 size_t aml_pool_max_used(aml_pool_t *h) {
     return h->max_used > h->used ? h->max_used : h->used;
@@ -31,6 +70,61 @@ void aml_pool_set_minimum_growth_size(aml_pool_t *h, size_t size) {
   h->minimum_growth_size = size;
 }
 
+void aml_pool_set_growth_fixed(aml_pool_t *h, size_t size) {
+  aml_pool_set_minimum_growth_size(h, size);
+  h->growth_cb = NULL;
+  h->growth_arg = NULL;
+  h->growth_max = 0;
+}
+
+void aml_pool_set_growth_geometric(aml_pool_t *h, size_t max_block_size) {
+  if (max_block_size == 0)
+    abort();
+  h->growth_cb = NULL;
+  h->growth_arg = NULL;
+  h->growth_max = max_block_size;
+}
+
+void aml_pool_set_growth_callback(aml_pool_t *h, aml_pool_growth_cb cb,
+                                  void *arg) {
+  h->growth_cb = cb;
+  h->growth_arg = cb ? arg : NULL;
+  h->growth_max = 0;
+}
+
+void aml_pool_set_side_threshold(aml_pool_t *h, size_t threshold) {
+  h->side_threshold = threshold;
+}
+
+size_t aml_pool_blocks(aml_pool_t *h) {
+  size_t n = 0;
+  for (aml_pool_node_t *block = h->current; block; block = block->prev)
+    n++;
+  return n;
+}
+
+void aml_pool_get_stats(aml_pool_t *h, aml_pool_stats_t *stats) {
+  memset(stats, 0, sizeof(*stats));
+#ifdef _AML_POOL_STATS_
+  stats->counting = true;
+  stats->allocs = __atomic_load_n(&h->counters.allocs, __ATOMIC_RELAXED);
+  stats->grows = __atomic_load_n(&h->counters.grows, __ATOMIC_RELAXED);
+  stats->clears = h->counters.clears;
+  stats->restores = h->counters.restores;
+  stats->align_bytes =
+      __atomic_load_n(&h->counters.align_bytes, __ATOMIC_RELAXED);
+  stats->wasted_bytes =
+      __atomic_load_n(&h->counters.wasted_bytes, __ATOMIC_RELAXED);
+#endif
+  stats->used = aml_pool_used(h);
+  stats->max_used = aml_pool_max_used(h);
+  stats->blocks = aml_pool_blocks(h);
+  for (aml_pool_node_t *block = h->side; block; block = block->prev)
+    stats->side_blocks++;
+  stats->retained_bytes = h->retained_bytes;
+  stats->numa_node = aml_pool_numa_node(h);
+}
+
 #ifdef _AML_DEBUG_
 static void dump_pool(FILE *out, const char *caller, void *p, size_t length) {
   (void)length;
@@ -60,7 +154,8 @@ aml_pool_t *_aml_pool_init(size_t initial_size) {
   /* If the initial_size is an even multiple of 4096, then reduce the block size
    so that the actual memory allocated via the system malloc is 4096 bytes. */
   size_t block_size = initial_size;
-  if ((block_size & 4096) == 0)
+  if ((block_size & 4095) == 0 &&
+      block_size > sizeof(aml_pool_t) + sizeof(aml_pool_node_t))
     block_size -= (sizeof(aml_pool_t) + sizeof(aml_pool_node_t));
 
   aml_pool_t *h;
@@ -87,7 +182,7 @@ aml_pool_t *_aml_pool_init(size_t initial_size) {
 #endif
   if (!h) /* what else might we do? */
     abort();
-  h->used = initial_size + sizeof(aml_pool_t) + sizeof(aml_pool_node_t);
+  h->used = block_size + sizeof(aml_pool_t) + sizeof(aml_pool_node_t);
   h->size = 0;
   h->max_used = 0;
   h->pool = NULL;
@@ -101,6 +196,80 @@ aml_pool_t *_aml_pool_init(size_t initial_size) {
 }
 
 
+aml_pool_t *aml_pool_init_ex(size_t initial_size,
+                             const aml_backing_allocator_t *allocator) {
+  if (initial_size == 0 || !allocator || !allocator->alloc || !allocator->free)
+    abort();
+  /* round initial_size up to be properly aligned */
+  initial_size += ((sizeof(size_t) - (initial_size & (sizeof(size_t) - 1))) &
+                   (sizeof(size_t) - 1));
+
+  /* the header, first node, and first block are allocated together just as
+     in _aml_pool_init */
+  size_t block_size = initial_size;
+  if ((block_size & 4095) == 0 &&
+      block_size > sizeof(aml_pool_t) + sizeof(aml_pool_node_t))
+    block_size -= (sizeof(aml_pool_t) + sizeof(aml_pool_node_t));
+
+  aml_pool_t *h = (aml_pool_t *)allocator->alloc(
+      allocator->ctx, block_size + sizeof(aml_pool_t) + sizeof(aml_pool_node_t));
+  if (!h)
+    abort();
+  memset(h, 0, sizeof(aml_pool_t) + sizeof(aml_pool_node_t));
+#ifdef _AML_DEBUG_
+  h->initial_size = initial_size;
+#endif
+  h->backing = allocator;
+  h->used = block_size + sizeof(aml_pool_t) + sizeof(aml_pool_node_t);
+  h->current = (aml_pool_node_t *)(h + 1);
+  h->curp = (char *)(h->current + 1);
+  h->current->endp = h->curp + block_size;
+  h->current->prev = NULL;
+
+  aml_pool_set_minimum_growth_size(h, initial_size);
+  return h;
+}
+
+aml_pool_t *aml_pool_init_external(void *mem, size_t len, int flags) {
+  /* the header is placed where malloc would have put it */
+  uintptr_t start = ((uintptr_t)mem + _Alignof(max_align_t) - 1) &
+                    ~(uintptr_t)(_Alignof(max_align_t) - 1);
+  size_t skip = start - (uintptr_t)mem;
+  size_t overhead = sizeof(aml_pool_t) + sizeof(aml_pool_node_t);
+  if (!mem || len < skip + overhead + sizeof(size_t))
+    return NULL;
+  size_t block_size = (len - skip - overhead) & ~(sizeof(size_t) - 1);
+
+  aml_pool_t *h = (aml_pool_t *)start;
+  memset(h, 0, overhead);
+#ifdef _AML_DEBUG_
+  h->initial_size = block_size;
+#endif
+  h->external = true;
+  h->fixed = (flags & AML_POOL_EXTERNAL_FIXED) != 0;
+  h->used = block_size + overhead;
+  h->current = (aml_pool_node_t *)(h + 1);
+  h->curp = (char *)(h->current + 1);
+  h->current->endp = h->curp + block_size;
+  h->current->prev = NULL;
+
+  aml_pool_set_minimum_growth_size(h, block_size);
+  return h;
+}
+
+#ifdef _AML_DEBUG_
+aml_pool_t *_aml_pool_init_concurrent(size_t initial_size, const char *caller) {
+  aml_pool_t *h = _aml_pool_init(initial_size, caller);
+#else
+aml_pool_t *_aml_pool_init_concurrent(size_t initial_size) {
+  aml_pool_t *h = _aml_pool_init(initial_size);
+#endif
+  h->lock = (struct aml_pool_lock_s *)aml_malloc(sizeof(struct aml_pool_lock_s));
+  if (!h->lock)
+    abort();
+  pthread_mutex_init(&h->lock->mutex, NULL);
+  return h;
+}
 
 aml_pool_t *aml_pool_pool_init(aml_pool_t *pool, size_t initial_size) {
   if (initial_size == 0)
@@ -128,22 +297,250 @@ aml_pool_t *aml_pool_pool_init(aml_pool_t *pool, size_t initial_size) {
 }
 
 
-void aml_pool_clear(aml_pool_t *h) {
-  /* remove the extra blocks (the ones where prev != NULL) */
-  aml_pool_node_t *prev = h->current->prev;
-  while (prev) {
-    if(!h->pool) {
+/* reads /sys/devices/system/node/online ("0-1,3") into mask, returns the
+   number of nodes found (0 if it can't be read) */
+static int _aml_numa_online(unsigned long *mask) {
+  FILE *in = fopen("/sys/devices/system/node/online", "r");
+  if (!in)
+    return 0;
+  int count = 0;
+  int lo, hi;
+  while (fscanf(in, "%d", &lo) == 1) {
+    hi = lo;
+    int ch = fgetc(in);
+    if (ch == '-') {
+      if (fscanf(in, "%d", &hi) != 1)
+        break;
+      ch = fgetc(in);
+    }
+    for (int n = lo; n <= hi && n < AML_NUMA_MAX_NODES; n++) {
+      if (n < 0)
+        continue;
+      mask[n / AML_NUMA_MASK_BITS] |= 1UL << (n % AML_NUMA_MASK_BITS);
+      count++;
+    }
+    if (ch != ',')
+      break;
+  }
+  fclose(in);
+  return count;
+}
+
+static void _aml_numa_bind(struct aml_pool_numa_s *numa, void *addr,
+                           size_t length) {
+  if (!numa->active)
+    return;
+  if (syscall(SYS_mbind, addr, length, numa->mode, numa->mask,
+              (unsigned long)AML_NUMA_MAX_NODES + 1, 0) != 0 &&
+      (errno == ENOSYS || errno == EPERM))
+    numa->active = false; /* no NUMA support, stop trying */
+}
+
+static void *_aml_pool_map(aml_pool_t *h, size_t length) {
+#ifdef MAP_HUGETLB
+  void *p = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (p != MAP_FAILED) {
+    h->pages = AML_POOL_PAGES_HUGETLB;
+    return p;
+  }
+#endif
+  /* Transparent huge pages only back 2 MB aligned ranges, so map an extra
+     2 MB and trim the mapping down to an aligned block. */
+  size_t span = length + AML_POOL_HUGE_PAGE_SIZE;
+  char *m = (char *)mmap(NULL, span, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (m == MAP_FAILED)
+    abort();
+  char *aligned = (char *)(((uintptr_t)m + AML_POOL_HUGE_PAGE_SIZE - 1) &
+                           ~(uintptr_t)(AML_POOL_HUGE_PAGE_SIZE - 1));
+  if (aligned > m)
+    munmap(m, aligned - m);
+  if (m + span > aligned + length)
+    munmap(aligned + length, (m + span) - (aligned + length));
+  h->pages = AML_POOL_PAGES_MMAP;
+#ifdef MADV_HUGEPAGE
+  if (madvise(aligned, length, MADV_HUGEPAGE) == 0)
+    h->pages = AML_POOL_PAGES_THP;
+#endif
+  return aligned;
+}
+
+/* All blocks other than the one allocated with the header are allocated and
+   released through these two functions. */
+static aml_pool_node_t *_aml_pool_block_alloc(aml_pool_t *h, size_t block_size) {
+  aml_pool_node_t *block;
+  if (h->fixed)
+    abort();
+  if (h->guard) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t length =
+        (sizeof(aml_pool_node_t) + block_size + page - 1) & ~(page - 1);
+    char *m = (char *)mmap(NULL, length + page, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (m == MAP_FAILED || mprotect(m + length, page, PROT_NONE) != 0)
+      abort();
+    block = (aml_pool_node_t *)m;
+    block->endp = m + length;
+    return block;
+  }
+  if (h->backing) {
+    block = (aml_pool_node_t *)h->backing->alloc(
+        h->backing->ctx, sizeof(aml_pool_node_t) + block_size);
+    if (!block)
+      abort();
+    block->endp = (char *)(block + 1) + block_size;
+    return block;
+  }
+  if (h->numa) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t length =
+        (sizeof(aml_pool_node_t) + block_size + page - 1) & ~(page - 1);
+    block = (aml_pool_node_t *)mmap(NULL, length, PROT_READ | PROT_WRITE,
+                                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (block == MAP_FAILED)
+      abort();
+    /* bind before the first touch so that the pages are placed correctly */
+    _aml_numa_bind(h->numa, block, length);
+    block->endp = (char *)block + length;
+    return block;
+  }
+  if (h->pages) {
+    size_t length = (sizeof(aml_pool_node_t) + block_size +
+                     AML_POOL_HUGE_PAGE_SIZE - 1) &
+                    ~(size_t)(AML_POOL_HUGE_PAGE_SIZE - 1);
+    block = (aml_pool_node_t *)_aml_pool_map(h, length);
+    block->endp = (char *)block + length;
+    return block;
+  }
+  if(!h->pool) {
 #ifdef _AML_USE_MALLOC_
-        free(h->current);
+    block = (aml_pool_node_t *)malloc(sizeof(aml_pool_node_t) + block_size);
 #else
-        aml_free(h->current);
-#endif
+    /* the depot may round the block up to its size class */
+    size_t length = sizeof(aml_pool_node_t) + block_size;
+    block = (aml_pool_node_t *)aml_pool_depot_alloc(&length);
+    if (block) {
+      block->endp = (char *)block + length;
+      return block;
     }
-    h->current = prev;
-    prev = prev->prev;
+    block = (aml_pool_node_t *)aml_malloc(sizeof(aml_pool_node_t) + block_size);
+#endif
   }
+  else
+    block = (aml_pool_node_t *)aml_pool_alloc(h->pool, sizeof(aml_pool_node_t) + block_size);
+  if (!block)
+    abort();
+  block->endp = (char *)(block + 1) + block_size;
+  return block;
+}
 
-  /* reset curp to the beginning */
+static void _aml_pool_block_free(aml_pool_t *h, aml_pool_node_t *block) {
+  if (h->guard)
+    munmap(block, block->endp - (char *)block + (size_t)sysconf(_SC_PAGESIZE));
+  else if (h->backing)
+    h->backing->free(h->backing->ctx, block, block->endp - (char *)block);
+  else if (h->pages || h->numa)
+    munmap(block, block->endp - (char *)block);
+  else if(!h->pool) {
+#ifdef _AML_USE_MALLOC_
+    free(block);
+#else
+    if (!aml_pool_depot_release(block, block->endp - (char *)block))
+      aml_free(block);
+#endif
+  }
+}
+
+/* frees blocks from the current one back until h->current->prev == prev and
+   returns how many were freed */
+static size_t _aml_pool_free_blocks(aml_pool_t *h, aml_pool_node_t *prev) {
+  size_t freed = 0;
+  while (h->current->prev != prev) {
+    aml_pool_node_t *block = h->current;
+    h->current = block->prev;
+    _aml_pool_block_free(h, block);
+    freed++;
+  }
+  return freed;
+}
+
+/* in stack mode, growth blocks that are no longer needed go to the retained
+   list (as long as the retain limit allows) */
+static void _aml_pool_release_block(aml_pool_t *h, aml_pool_node_t *block) {
+  size_t bytes = block->endp - (char *)block;
+  if (h->stack_mode &&
+      (!h->retain_limit || h->retained_bytes + bytes <= h->retain_limit)) {
+    block->prev = h->retained;
+    h->retained = block;
+    h->retained_bytes += bytes;
+  } else
+    _aml_pool_block_free(h, block);
+}
+
+/* used by aml_pool_restore, like _aml_pool_free_blocks except that the
+   blocks may be retained.  Walking back from the newest block leaves the
+   oldest at the head of the retained list, so reuse follows the original
+   order. */
+void _aml_pool_release_blocks(aml_pool_t *h, aml_pool_node_t *prev) {
+  while (h->current->prev != prev) {
+    aml_pool_node_t *block = h->current;
+    h->current = block->prev;
+    _aml_pool_release_block(h, block);
+  }
+}
+
+void aml_pool_set_stack_mode(aml_pool_t *h, bool enabled) {
+  h->stack_mode = enabled;
+}
+
+/* the slow path of aml_pool_pop, p isn't the top of the current block */
+bool _aml_pool_pop_block(aml_pool_t *h, char *p, size_t len) {
+  aml_pool_node_t *block = h->current;
+  aml_pool_node_t *prev = block->prev;
+  /* p must have been the last allocation in prev */
+  if (!prev || h->curp != (char *)(block + 1) || p < (char *)(prev + 1) ||
+      p + len != prev->usedp)
+    return false;
+  h->used -= block->endp - (char *)block;
+  /* growth counted the tail of prev in size, take it back so that
+     oscillating across the boundary doesn't keep adding to it */
+  if (prev->prev) {
+    size_t tail = prev->endp - prev->usedp;
+    h->size -= tail < h->size ? tail : h->size;
+  }
+  h->current = prev;
+  h->curp = p;
+#ifdef _AML_DEBUG_
+  h->cur_size -= prev->usedp - p;
+#endif
+  _aml_pool_release_block(h, block);
+  return true;
+}
+
+/* frees side blocks until h->side == side */
+void _aml_pool_free_side_blocks(aml_pool_t *h, aml_pool_node_t *side) {
+  while (h->side != side) {
+    aml_pool_node_t *block = h->side;
+    h->side = block->prev;
+    _aml_pool_block_free(h, block);
+  }
+}
+
+static void _aml_pool_free_retained(aml_pool_t *h) {
+  aml_pool_node_t *block = h->retained;
+  while (block) {
+    aml_pool_node_t *prev = block->prev;
+    _aml_pool_block_free(h, block);
+    block = prev;
+  }
+  h->retained = NULL;
+  h->retained_bytes = 0;
+}
+
+/* reset curp to the beginning of the first block, h->current must already
+   point to the first block. */
+static void _aml_pool_rewind(aml_pool_t *h) {
   h->curp = (char *)(h->current + 1);
 
   /* reset size and used */
@@ -155,14 +552,540 @@ void aml_pool_clear(aml_pool_t *h) {
 #endif
   h->used =
       (h->current->endp - h->curp) + sizeof(aml_pool_t) + sizeof(aml_pool_node_t);
+
+  /* the block allocated with the header is still held after adaptive mode
+     replaces the first block */
+  aml_pool_node_t *first = (aml_pool_node_t *)(h + 1);
+  if (h->current != first)
+    h->used += first->endp - (char *)first;
+
+  /* every allocation goes to _aml_pool_guard_alloc */
+  if (h->guard == AML_POOL_GUARD_ALLOCS)
+    h->curp = h->current->endp;
+}
+
+#ifdef _AML_DEBUG_
+aml_pool_t *_aml_pool_init_hugepages(size_t initial_size, const char *caller) {
+  if (initial_size == 0)
+    abort();
+  /* the header keeps a token first block, the real one is mapped separately
+     in the same way that adaptive mode replaces the first block */
+  aml_pool_t *h = _aml_pool_init(sizeof(size_t), caller);
+  h->initial_size = initial_size;
+#else
+aml_pool_t *_aml_pool_init_hugepages(size_t initial_size) {
+  if (initial_size == 0)
+    abort();
+  /* the header keeps a token first block, the real one is mapped separately
+     in the same way that adaptive mode replaces the first block */
+  aml_pool_t *h = _aml_pool_init(sizeof(size_t));
+#endif
+  h->pages = AML_POOL_PAGES_MMAP;
+  h->current = _aml_pool_block_alloc(h, initial_size);
+  h->current->prev = NULL;
+  _aml_pool_rewind(h);
+  h->max_used = 0;
+  aml_pool_set_minimum_growth_size(h, initial_size);
+  return h;
+}
+
+#ifdef _AML_DEBUG_
+aml_pool_t *_aml_pool_init_guarded(size_t initial_size, aml_pool_guard_t mode,
+                                   const char *caller) {
+  if (initial_size == 0 ||
+      (mode != AML_POOL_GUARD_BLOCKS && mode != AML_POOL_GUARD_ALLOCS))
+    abort();
+  aml_pool_t *h = _aml_pool_init(sizeof(size_t), caller);
+  h->initial_size = initial_size;
+#else
+aml_pool_t *_aml_pool_init_guarded(size_t initial_size, aml_pool_guard_t mode) {
+  if (initial_size == 0 ||
+      (mode != AML_POOL_GUARD_BLOCKS && mode != AML_POOL_GUARD_ALLOCS))
+    abort();
+  aml_pool_t *h = _aml_pool_init(sizeof(size_t));
+#endif
+  h->guard = mode;
+  h->pages = AML_POOL_PAGES_MMAP;
+  /* like hugepage pools, the real first block is mapped separately.  When
+     every allocation has its own block, the first one is never used. */
+  h->current = _aml_pool_block_alloc(
+      h, mode == AML_POOL_GUARD_ALLOCS ? sizeof(size_t) : initial_size);
+  h->current->prev = NULL;
+  _aml_pool_rewind(h);
+  h->max_used = 0;
+  aml_pool_set_minimum_growth_size(h, initial_size);
+  return h;
+}
+
+#ifdef _AML_DEBUG_
+aml_pool_t *_aml_pool_init_numa(size_t initial_size,
+                                aml_pool_numa_policy_t policy, int node,
+                                const char *caller) {
+  if (initial_size == 0)
+    abort();
+  aml_pool_t *h = _aml_pool_init(sizeof(size_t), caller);
+  h->initial_size = initial_size;
+#else
+aml_pool_t *_aml_pool_init_numa(size_t initial_size,
+                                aml_pool_numa_policy_t policy, int node) {
+  if (initial_size == 0)
+    abort();
+  aml_pool_t *h = _aml_pool_init(sizeof(size_t));
+#endif
+  struct aml_pool_numa_s *numa =
+      (struct aml_pool_numa_s *)aml_zalloc(sizeof(struct aml_pool_numa_s));
+  if (!numa)
+    abort();
+  unsigned long online[AML_NUMA_MAX_NODES / AML_NUMA_MASK_BITS] = {0};
+  int nodes = _aml_numa_online(online);
+
+  if (policy == AML_POOL_NUMA_INTERLEAVE) {
+    numa->node = -1;
+    numa->mode = AML_MPOL_INTERLEAVE;
+    memcpy(numa->mask, online, sizeof(online));
+  } else {
+    if (policy == AML_POOL_NUMA_LOCAL) {
+      unsigned cpu = 0, local = 0;
+      if (syscall(SYS_getcpu, &cpu, &local, NULL) != 0)
+        local = 0;
+      node = (int)local;
+      numa->mode = AML_MPOL_PREFERRED;
+    } else
+      numa->mode = AML_MPOL_BIND;
+    if (node < 0 || node >= AML_NUMA_MAX_NODES)
+      abort();
+    numa->node = node;
+    numa->mask[node / AML_NUMA_MASK_BITS] = 1UL << (node % AML_NUMA_MASK_BITS);
+  }
+  numa->active = nodes > 1;
+  h->numa = numa;
+
+  /* like hugepage pools, the real first block is mapped separately */
+  h->current = _aml_pool_block_alloc(h, initial_size);
+  h->current->prev = NULL;
+  _aml_pool_rewind(h);
+  h->max_used = 0;
+  aml_pool_set_minimum_growth_size(h, initial_size);
+  return h;
+}
+
+int aml_pool_numa_node(aml_pool_t *h) { return h->numa ? h->numa->node : -1; }
+
+/* adds the pages of [p, p + length) to pages[], returns the number counted */
+static size_t _aml_numa_count(char *p, size_t length, size_t *pages,
+                              size_t num_nodes, bool *ok) {
+  enum { CHUNK = 256 };
+  void *addrs[CHUNK];
+  int status[CHUNK];
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  char *start = (char *)((uintptr_t)p & ~(uintptr_t)(page - 1));
+  char *end = p + length;
+  size_t counted = 0;
+  while (start < end && *ok) {
+    unsigned long n = 0;
+    for (; n < CHUNK && start < end; n++, start += page)
+      addrs[n] = start;
+    if (syscall(SYS_move_pages, 0, n, addrs, NULL, status, 0) != 0) {
+      *ok = false;
+      break;
+    }
+    for (unsigned long i = 0; i < n; i++) {
+      if (status[i] < 0)
+        continue;
+      if ((size_t)status[i] < num_nodes)
+        pages[status[i]]++;
+      counted++;
+    }
+  }
+  return counted;
+}
+
+size_t aml_pool_numa_placement(aml_pool_t *h, size_t *pages, size_t num_nodes) {
+  for (size_t i = 0; i < num_nodes; i++)
+    pages[i] = 0;
+  if (h->pool)
+    return 0;
+  bool ok = true;
+  aml_pool_node_t *first = (aml_pool_node_t *)(h + 1);
+  size_t counted =
+      _aml_numa_count((char *)h, first->endp - (char *)h, pages, num_nodes, &ok);
+  for (aml_pool_node_t *b = h->current; b && b != first; b = b->prev)
+    counted += _aml_numa_count((char *)b, b->endp - (char *)b, pages,
+                               num_nodes, &ok);
+  for (aml_pool_node_t *b = h->side; b; b = b->prev)
+    counted += _aml_numa_count((char *)b, b->endp - (char *)b, pages,
+                               num_nodes, &ok);
+  if (!ok) {
+    for (size_t i = 0; i < num_nodes; i++)
+      pages[i] = 0;
+    return 0;
+  }
+  return counted;
+}
+
+aml_pool_pages_t aml_pool_pages(aml_pool_t *h) {
+  return (aml_pool_pages_t)h->pages;
+}
+
+void aml_pool_set_adaptive(aml_pool_t *h, size_t cycles) {
+  if (h->adaptive) {
+    aml_free(h->adaptive);
+    h->adaptive = NULL;
+  }
+  if (!cycles)
+    return;
+  if (cycles > SIZE_MAX / (2 * sizeof(size_t)) - 1)
+    abort();
+  h->adaptive = (struct aml_pool_adaptive_s *)aml_zalloc(
+      sizeof(struct aml_pool_adaptive_s) + 2 * cycles * sizeof(size_t));
+  if (!h->adaptive)
+    abort();
+  h->adaptive->cycles = cycles;
+}
+
+size_t aml_pool_adaptive_size(aml_pool_t *h) {
+  return h->adaptive ? h->adaptive->learned : 0;
+}
+
+/* Records the bytes used since the last clear.  Growth blocks count in full
+   because a single block would have needed to hold their contents. */
+static void _aml_pool_adaptive_record(aml_pool_t *h) {
+  struct aml_pool_adaptive_s *a = h->adaptive;
+  size_t peak = h->curp - (char *)(h->current + 1);
+  for (aml_pool_node_t *block = h->current->prev; block; block = block->prev)
+    peak += block->endp - (char *)(block + 1);
+
+  a->peaks[a->pos] = peak;
+  a->pos = (a->pos + 1) % a->cycles;
+  if (a->count < a->cycles)
+    a->count++;
+}
+
+static size_t _aml_pool_adaptive_p95(struct aml_pool_adaptive_s *a) {
+  /* the window is small, so an insertion sort into the scratch space that
+     follows the peaks is fine */
+  size_t *sorted = a->peaks + a->cycles;
+  for (size_t i = 0; i < a->count; i++) {
+    size_t v = a->peaks[i];
+    size_t j = i;
+    while (j && sorted[j - 1] > v) {
+      sorted[j] = sorted[j - 1];
+      j--;
+    }
+    sorted[j] = v;
+  }
+  return sorted[(a->count * 95 + 99) / 100 - 1];
+}
+
+/* called after the growth blocks are gone and h->current is the first block */
+static void _aml_pool_adaptive_resize(aml_pool_t *h) {
+  struct aml_pool_adaptive_s *a = h->adaptive;
+  if (a->count < a->cycles)
+    return;
+
+  /* round so that the block and its node fill whole pages, the +1 is because
+     the fast path needs r + len < endp */
+  size_t target = _aml_pool_adaptive_p95(a) + 1 + sizeof(aml_pool_node_t);
+  target = ((target + 4095) & ~(size_t)4095) - sizeof(aml_pool_node_t);
+  a->learned = target;
+
+  /* the first block of an external pool is the caller's memory */
+  if (h->pool || h->external)
+    return;
+
+  aml_pool_node_t *first = h->current;
+  bool is_inline = first == (aml_pool_node_t *)(h + 1);
+  size_t capacity = first->endp - (char *)(first + 1);
+  if (target > capacity || (!is_inline && target < capacity / 2)) {
+    aml_pool_node_t *block = _aml_pool_block_alloc(h, target);
+    block->prev = NULL;
+    if (!is_inline)
+      _aml_pool_block_free(h, first);
+    h->current = block;
+  }
+}
+
+/* interned strings last until the pool is cleared */
+static void _aml_pool_intern_clear(aml_pool_t *h) {
+  if (h->intern_pool) {
+    aml_pool_clear(h->intern_pool);
+    h->intern = NULL;
+  }
+}
+
+void aml_pool_clear(aml_pool_t *h) {
+  _aml_pool_count(h, clears, 1);
+  _aml_pool_intern_clear(h);
+  if (h->adaptive)
+    _aml_pool_adaptive_record(h);
+  size_t used = h->used;
+  /* remove the extra blocks (the ones where prev != NULL) */
+  size_t freed = _aml_pool_free_blocks(h, NULL);
+  AML_PROBE3(pool_clear, h, used, freed);
+  _aml_pool_free_side_blocks(h, NULL);
+  _aml_pool_free_retained(h);
+  if (h->adaptive)
+    _aml_pool_adaptive_resize(h);
+  _aml_pool_rewind(h);
+}
+
+void aml_pool_set_retain_limit(aml_pool_t *h, size_t max_bytes) {
+  h->retain_limit = max_bytes;
+}
+
+void aml_pool_clear_retain(aml_pool_t *h) {
+  /* Walking from the newest block back and pushing each onto the retained
+     list leaves the oldest growth block at the head, so the blocks are reused
+     in the same order that they were originally added.  Blocks retained by a
+     previous clear that went unused this time stay behind them. */
+  _aml_pool_count(h, clears, 1);
+  _aml_pool_intern_clear(h);
+  if (h->adaptive)
+    _aml_pool_adaptive_record(h);
+  _aml_pool_free_side_blocks(h, NULL);
+  size_t used = h->used, moved = 0;
+  aml_pool_node_t *prev = h->current->prev;
+  while (prev) {
+    moved++;
+    aml_pool_node_t *block = h->current;
+    block->prev = h->retained;
+    h->retained = block;
+    h->retained_bytes += block->endp - (char *)block;
+    h->current = prev;
+    prev = prev->prev;
+  }
+
+  AML_PROBE3(pool_clear, h, used, moved);
+  if (h->retain_limit && h->retained_bytes > h->retain_limit) {
+    /* keep the blocks that will be reused first and free the rest */
+    size_t kept = 0;
+    aml_pool_node_t **tail = &h->retained;
+    while (*tail && kept + ((*tail)->endp - (char *)(*tail)) <= h->retain_limit) {
+      kept += (*tail)->endp - (char *)(*tail);
+      tail = &(*tail)->prev;
+    }
+    aml_pool_node_t *block = *tail;
+    *tail = NULL;
+    while (block) {
+      prev = block->prev;
+      _aml_pool_block_free(h, block);
+      block = prev;
+    }
+    h->retained_bytes = kept;
+  }
+  if (h->adaptive)
+    _aml_pool_adaptive_resize(h);
+  _aml_pool_rewind(h);
+}
+
+/* the used part of one old block and where it went */
+typedef struct {
+  char *old_start;
+  char *old_end;
+  char *new_start;
+} aml_pool_segment_t;
+
+struct aml_pool_relocation_s {
+  /* in copy order, so new_start is ascending */
+  aml_pool_segment_t *by_new;
+  /* sorted by old_start */
+  aml_pool_segment_t **by_old;
+  size_t num;
+};
+
+static int _aml_pool_segment_cmp(const void *a, const void *b) {
+  const aml_pool_segment_t *x = *(aml_pool_segment_t *const *)a;
+  const aml_pool_segment_t *y = *(aml_pool_segment_t *const *)b;
+  return x->old_start < y->old_start ? -1 : x->old_start > y->old_start;
+}
+
+void *aml_pool_relocate(const aml_pool_relocation_t *r, const void *p) {
+  const char *cp = (const char *)p;
+  size_t lo = 0, hi = r->num;
+  /* find the last segment which starts at or before p */
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (r->by_old[mid]->old_start <= cp)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  /* a block's node sits between the end of one segment and the start of the
+     next, so one past the end of a segment is never the start of another */
+  if (lo && cp <= r->by_old[lo - 1]->old_end) {
+    aml_pool_segment_t *seg = r->by_old[lo - 1];
+    return seg->new_start + (cp - seg->old_start);
+  }
+  return (void *)cp;
+}
+
+void aml_pool_relocate_offset(const aml_pool_relocation_t *r, int64_t *rp) {
+  if (!*rp)
+    return;
+  char *np = (char *)rp;
+  char *op = np;
+  size_t lo = 0, hi = r->num;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (r->by_new[mid].new_start <= np)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo) {
+    aml_pool_segment_t *seg = r->by_new + lo - 1;
+    if (np < seg->new_start + (seg->old_end - seg->old_start))
+      op = seg->old_start + (np - seg->new_start);
+  }
+  char *target = (char *)aml_pool_relocate(r, op + *rp);
+  *rp = target - np;
+}
+
+void *aml_pool_compact(aml_pool_t *h, size_t *len, aml_pool_relocate_cb cb,
+                       void *arg) {
+  _aml_pool_free_retained(h);
+  aml_pool_node_t *first = (aml_pool_node_t *)(h + 1);
+  bool single = !h->current->prev && !h->side;
+  if (single && h->current == first) {
+    char *start = (char *)(h->current + 1);
+    if (len)
+      *len = h->curp - start;
+    return start;
+  }
+
+  size_t num = 0;
+  for (aml_pool_node_t *block = h->current; block; block = block->prev)
+    num++;
+  size_t num_main = num;
+  for (aml_pool_node_t *block = h->side; block; block = block->prev)
+    num++;
+
+  aml_pool_relocation_t r;
+  r.num = num;
+  r.by_new = (aml_pool_segment_t *)aml_malloc(num * sizeof(aml_pool_segment_t));
+  r.by_old = (aml_pool_segment_t **)aml_malloc(num * sizeof(aml_pool_segment_t *));
+  if (!r.by_new || !r.by_old)
+    abort();
+
+  /* the main blocks oldest first, then the side blocks oldest first */
+  size_t i = num_main;
+  size_t live = 0;
+  for (aml_pool_node_t *block = h->current; block; block = block->prev) {
+    aml_pool_segment_t *seg = r.by_new + --i;
+    seg->old_start = (char *)(block + 1);
+    seg->old_end = block == h->current ? h->curp : block->usedp;
+    live += seg->old_end - seg->old_start;
+  }
+  i = num;
+  for (aml_pool_node_t *block = h->side; block; block = block->prev) {
+    aml_pool_segment_t *seg = r.by_new + --i;
+    seg->old_start = (char *)(block + 1);
+    seg->old_end = block->usedp;
+    live += seg->old_end - seg->old_start;
+  }
+
+  /* lay the segments out from a line aligned origin, each keeping its offset
+     within a line, then place the origin on a line in the new block (the + 1
+     is because the fast path needs r + len < endp) */
+  size_t length = 0;
+  for (i = 0; i < num; i++) {
+    aml_pool_segment_t *seg = r.by_new + i;
+    length += ((uintptr_t)seg->old_start - length) & 63;
+    seg->new_start = (char *)length;
+    length += seg->old_end - seg->old_start;
+  }
+
+  /* The block allocated with the header can't be freed, so the image goes
+     there when it fits.  If that block is the oldest segment, its contents
+     are already in place and the image starts where they do.  Otherwise the
+     block is idle (an earlier compaction moved off of it) and the image
+     starts on the first line within it. */
+  char *base = (char *)(first + 1);
+  bool keep_first = r.by_new[0].old_start == base;
+  char *origin;
+  aml_pool_node_t *image;
+  if (keep_first)
+    origin = base - ((uintptr_t)base & 63);
+  else
+    origin = (char *)(((uintptr_t)base + 63) & ~(uintptr_t)63);
+  if (origin + length < first->endp) {
+    image = first;
+  } else if (single) {
+    /* copying a lone block to a new one gains nothing */
+    char *start = (char *)(h->current + 1);
+    aml_free(r.by_old);
+    aml_free(r.by_new);
+    if (len)
+      *len = h->curp - start;
+    return start;
+  } else {
+    image = _aml_pool_block_alloc(h, length + 63 + 1);
+    origin = (char *)(((uintptr_t)(image + 1) + 63) & ~(uintptr_t)63);
+    keep_first = false;
+  }
+  image->prev = NULL;
+  for (i = 0; i < num; i++) {
+    aml_pool_segment_t *seg = r.by_new + i;
+    seg->new_start = origin + (size_t)seg->new_start;
+    if (!keep_first || i)
+      memcpy(seg->new_start, seg->old_start, seg->old_end - seg->old_start);
+    r.by_old[i] = seg;
+  }
+  char *start = keep_first ? base : origin;
+  char *d = origin + length;
+  qsort(r.by_old, num, sizeof(aml_pool_segment_t *), _aml_pool_segment_cmp);
+
+  if (cb)
+    cb(arg, &r);
+  aml_free(r.by_old);
+  aml_free(r.by_new);
+
+  while (h->current) {
+    aml_pool_node_t *block = h->current;
+    h->current = block->prev;
+    if (block != first)
+      _aml_pool_block_free(h, block);
+  }
+  _aml_pool_free_side_blocks(h, NULL);
+
+  if (h->used > h->max_used)
+    h->max_used = h->used;
+  h->current = image;
+  h->curp = d;
+  /* see aml_pool_realloc_last */
+  if (h->guard == AML_POOL_GUARD_ALLOCS)
+    h->curp = image->endp;
+  h->size = 0;
+  h->used = sizeof(aml_pool_t) + (first->endp - (char *)first);
+  if (image != first)
+    h->used += (image->endp - (char *)(image + 1)) + sizeof(aml_pool_node_t);
+  if (len)
+    *len = d - start;
+  return start;
 }
 
 void aml_pool_destroy(aml_pool_t *h) {
   /* pool_clear frees all of the memory from all of the extra nodes and only
     leaves the main block and main node allocated */
+  AML_PROBE3(pool_destroy, h, aml_pool_used(h), aml_pool_max_used(h));
+  aml_pool_set_adaptive(h, 0);
   aml_pool_clear(h);
+  if (h->intern_pool)
+    aml_pool_destroy(h->intern_pool);
+  if (h->lock) {
+    pthread_mutex_destroy(&h->lock->mutex);
+    aml_free(h->lock);
+  }
+  /* adaptive mode may have replaced the first block */
+  if (h->current != (aml_pool_node_t *)(h + 1))
+    _aml_pool_block_free(h, h->current);
+  if (h->numa)
+    aml_free(h->numa);
   /* free the main block and the main node */
-  if(!h->pool) {
+  if (h->backing) {
+    aml_pool_node_t *first = (aml_pool_node_t *)(h + 1);
+    h->backing->free(h->backing->ctx, h, first->endp - (char *)h);
+  } else if(!h->pool && !h->external) {
 #ifdef _AML_USE_MALLOC_
     free(h);
 #else
@@ -172,6 +1095,41 @@ void aml_pool_destroy(aml_pool_t *h) {
 }
 
 
+__thread aml_pool_t *_aml_pool_tls = NULL;
+
+/* The thread local pointer gives aml_pool_tls_get a single load on the fast
+   path.  The key is only there so that the pool is destroyed when the thread
+   exits. */
+static pthread_key_t tls_key;
+static pthread_once_t tls_once = PTHREAD_ONCE_INIT;
+
+static void tls_pool_destroy(void *p) {
+  aml_pool_destroy((aml_pool_t *)p);
+  _aml_pool_tls = NULL;
+}
+
+static void tls_key_init(void) {
+  if (pthread_key_create(&tls_key, tls_pool_destroy))
+    abort();
+}
+
+aml_pool_t *_aml_pool_tls_init(size_t size) {
+  pthread_once(&tls_once, tls_key_init);
+  aml_pool_t *h = aml_pool_init(size);
+  pthread_setspecific(tls_key, h);
+  _aml_pool_tls = h;
+  return h;
+}
+
+void aml_pool_tls_destroy(void) {
+  aml_pool_t *h = _aml_pool_tls;
+  if (!h)
+    return;
+  pthread_setspecific(tls_key, NULL);
+  _aml_pool_tls = NULL;
+  aml_pool_destroy(h);
+}
+
 void *aml_pool_aalloc(aml_pool_t *pool, size_t alignment, size_t size) {
 #ifdef _AML_DEBUG_
     // Only check in debug mode
@@ -190,6 +1148,8 @@ void *aml_pool_aalloc(aml_pool_t *pool, size_t alignment, size_t size) {
         void *result = pool->curp;
         pool->curp += size;  // Reserve the requested size
         pool->used += padding + size;  // Update used size
+        _aml_pool_count(pool, allocs, 1);
+        _aml_pool_count(pool, align_bytes, padding);
 #ifdef _AML_DEBUG_
         pool->cur_size += padding + size;
 #endif
@@ -197,42 +1157,168 @@ void *aml_pool_aalloc(aml_pool_t *pool, size_t alignment, size_t size) {
     }
 
     // Not enough space in the current block, grow the pool and allocate aligned
-    size_t total_size = size + alignment - 1;  // Account for alignment padding
-    char *block = (char *)_aml_pool_alloc_grow(pool, total_size);
-    aligned = ((uintptr_t)block + alignment - 1) & ~(alignment - 1);
-    return (void *)aligned;
+    return _aml_pool_aalloc_grow(pool, alignment, size);
+}
+
+/* Gives the allocation a block of its own, placed so that it ends at the
+   guard page, or as close as an explicit alignment allows.  curp is left at
+   the end of the block so that the next allocation comes back here as
+   well. */
+static void *_aml_pool_guard_alloc(aml_pool_t *h, size_t alignment,
+                                   size_t len) {
+  if (len > SIZE_MAX / 2)
+    abort();
+  /* room to round the start down to an aligned address */
+  aml_pool_node_t *block = _aml_pool_block_alloc(h, len + alignment);
+  h->used += block->endp - (char *)block;
+  block->prev = h->current;
+  h->current->usedp = h->curp;
+  h->current = block;
+  h->curp = block->endp;
+  char *r = (char *)((uintptr_t)(block->endp - len) &
+                     ~(uintptr_t)(alignment - 1));
+  _aml_pool_count(h, allocs, 1);
+  _aml_pool_count(h, grows, 1);
+#ifdef _AML_DEBUG_
+  h->cur_size += len;
+#endif
+  return r;
 }
 
+void *_aml_pool_aalloc_grow(aml_pool_t *h, size_t alignment, size_t len) {
+  if (h->guard == AML_POOL_GUARD_ALLOCS)
+    return _aml_pool_guard_alloc(h, alignment, len);
+  /* new blocks already start at that alignment */
+  if (alignment <= sizeof(size_t))
+    return _aml_pool_alloc_grow(h, len);
+  char *block = (char *)_aml_pool_alloc_grow(h, len + alignment - 1);
+  uintptr_t aligned = ((uintptr_t)block + alignment - 1) & ~(alignment - 1);
+  _aml_pool_count(h, align_bytes, aligned - (uintptr_t)block);
+  return (void *)aligned;
+}
 
 void *_aml_pool_alloc_grow(aml_pool_t *h, size_t len) {
-  size_t block_size = len;
-  if (block_size < h->minimum_growth_size)
-    block_size = h->minimum_growth_size;
-  aml_pool_node_t *block;
+  /* ending at the page aligns the start to the largest power of two that
+     divides len, which is the alignment of any array of objects len fills */
+  if (h->guard == AML_POOL_GUARD_ALLOCS)
+    return _aml_pool_guard_alloc(h, 1, len);
+  if (h->side_threshold && len >= h->side_threshold) {
+    /* keep the current block and give the request a block of its own */
+    aml_pool_node_t *block = _aml_pool_block_alloc(h, len);
+    block->prev = h->side;
+    block->usedp = (char *)(block + 1) + len;
+    h->side = block;
+    h->used += block->endp - (char *)block;
+    _aml_pool_count_atomic(h, allocs, 1);
+    _aml_pool_count_atomic(h, grows, 1);
+#ifdef _AML_DEBUG_
+    __atomic_fetch_add(&h->cur_size, len, __ATOMIC_RELAXED);
+#endif
+    AML_PROBE3(pool_side_block, h, len, block->endp - (char *)block);
+    return block + 1;
+  }
+
+  size_t block_size = h->minimum_growth_size;
+  if (h->growth_cb)
+    block_size = h->growth_cb(h->growth_arg, aml_pool_used(h), len);
+  else if (h->growth_max) {
+    /* geometric, match the footprint so far */
+    block_size = aml_pool_used(h);
+    if (block_size < h->minimum_growth_size)
+      block_size = h->minimum_growth_size;
+    if (block_size > h->growth_max)
+      block_size = h->growth_max;
+  }
+  if (block_size < len)
+    block_size = len;
   // if(len > 100*1024*1024)
   //  printf("aml_pool_t: %p(%p): growing to %lu, %lu\n", h, h->pool, block_size, h->size);
-  if(!h->pool) {
-#ifdef _AML_USE_MALLOC_
-    block = (aml_pool_node_t *)malloc(sizeof(aml_pool_node_t) + block_size);
-#else
-    block = (aml_pool_node_t *)aml_malloc(sizeof(aml_pool_node_t) + block_size);
+  aml_pool_node_t *block = h->retained;
+  if (block && (size_t)(block->endp - (char *)(block + 1)) >= len) {
+    h->retained = block->prev;
+    h->retained_bytes -= block->endp - (char *)block;
+  } else
+    block = _aml_pool_block_alloc(h, block_size);
+  h->used += block->endp - (char *)block;
+  aml_pool_node_t *prev = h->current;
+  block->prev = prev;
+  char *r = (char *)(block + 1);
+  /* publish current before curp so that concurrent readers never pair the
+     new block's curp with the old block (see _aml_pool_concurrent_reserve).
+     The exchange returns where the old block really ended, including any
+     reservation that raced with the growth. */
+  __atomic_store_n(&h->current, block, __ATOMIC_RELEASE);
+  prev->usedp = __atomic_exchange_n(&h->curp, r + len, __ATOMIC_ACQ_REL);
+  if (prev->prev)
+    h->size += prev->endp - prev->usedp;
+  _aml_pool_count_atomic(h, allocs, 1);
+  _aml_pool_count_atomic(h, grows, 1);
+  _aml_pool_count_atomic(h, wasted_bytes, (size_t)(prev->endp - prev->usedp));
+  AML_PROBE5(pool_grow, h, len, block->endp - (char *)block, h->used,
+             prev->endp - prev->usedp);
+#ifdef _AML_DEBUG_
+  __atomic_fetch_add(&h->cur_size, len, __ATOMIC_RELAXED);
 #endif
-  }
-  else
-    block = (aml_pool_node_t *)aml_pool_alloc(h->pool, sizeof(aml_pool_node_t) + block_size);
-  if (!block)
+  return r;
+}
+
+void aml_pool_alloc_batch(aml_pool_t *h, size_t count, size_t size,
+                          void **out) {
+  if (!count)
+    return;
+  /* every object keeps the alignment of aml_pool_alloc */
+  size_t stride = (size + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1);
+  if (stride < size)
     abort();
-  if (h->current->prev)
-    h->size += (h->current->endp - h->curp);
-  h->used += sizeof(aml_pool_node_t) + block_size;
-  block->prev = h->current;
-  h->current = block;
-  char *r = (char *)(block + 1);
-  block->endp = r + block_size;
-  h->curp = r + len;
+  size_t to_add = ((sizeof(size_t) - ((size_t)(h->curp) & (sizeof(size_t) - 1))) &
+                   (sizeof(size_t) - 1));
+  char *r = h->curp + to_add;
+  /* like aml_pool_alloc, the last object must end before endp */
+  size_t avail = r < h->current->endp ? (size_t)(h->current->endp - r) - 1 : 0;
+  size_t n = stride ? avail / stride : count;
+  if (n > count)
+    n = count;
+  if (n) {
+    h->curp = r + n * stride;
 #ifdef _AML_DEBUG_
-  h->cur_size += len;
+    h->cur_size += n * stride;
 #endif
+    _aml_pool_count(h, allocs, n);
+    _aml_pool_count(h, align_bytes, to_add);
+    for (size_t i = 0; i < n; i++, r += stride)
+      out[i] = r;
+    if (n == count)
+      return;
+  }
+
+  /* guarded objects each get their own block */
+  if (h->guard == AML_POOL_GUARD_ALLOCS) {
+    for (size_t i = n; i < count; i++)
+      out[i] = _aml_pool_guard_alloc(h, 1, size);
+    return;
+  }
+
+  /* the rest go to one new block */
+  size_t rest = count - n;
+  if (rest > SIZE_MAX / stride)
+    abort();
+  r = (char *)_aml_pool_alloc_grow(h, rest * stride);
+  _aml_pool_count(h, allocs, rest - 1);
+  out += n;
+  for (size_t i = 0; i < rest; i++, r += stride)
+    out[i] = r;
+}
+
+void *_aml_pool_concurrent_alloc_grow(aml_pool_t *h, aml_pool_node_t *current,
+                                      size_t len) {
+  pthread_mutex_lock(&h->lock->mutex);
+  if (__atomic_load_n(&h->current, __ATOMIC_ACQUIRE) != current) {
+    /* another thread grew the pool while this one waited for the lock */
+    pthread_mutex_unlock(&h->lock->mutex);
+    return aml_pool_concurrent_alloc(h, len);
+  }
+  void *r = _aml_pool_alloc_grow(h, len);
+  pthread_mutex_unlock(&h->lock->mutex);
   return r;
 }
 
@@ -247,6 +1333,7 @@ char *aml_pool_strdupvf(aml_pool_t *pool, const char *fmt, va_list args) {
   va_end(args_copy);
   if ((size_t)n < leftover) {
     pool->curp += n + 1;
+    _aml_pool_count(pool, allocs, 1);
 #ifdef _AML_DEBUG_
     pool->cur_size += (n + 1);
 #endif
@@ -344,32 +1431,25 @@ char **_aml_pool_split(aml_pool_t *h, size_t *num_splits, char delim, char *s) {
       *num_splits = 0;
     return &nil;
   }
-  char *p = s;
-  size_t num = 1;
-  while (*p != 0) {
-    if (*p == delim)
-      num++;
-    p++;
-  }
-  if (num_splits)
-    *num_splits = num;
-  char **r = (char **)aml_pool_alloc(h, sizeof(char *) * (num + 1));
-  char **wr = r;
-  *wr = s;
-  wr++;
+  /* s is normally the last allocation, so the vector grows in place after it
+     and the string is only scanned once */
+  aml_pool_vec_t v;
+  aml_pool_vec_init(&v, h, sizeof(char *), 0);
+  aml_pool_vec_push_value(&v, char *, s);
     // ,,, => "","","",""
 
   while (*s != 0) {
     if (*s == delim) {
       *s = 0;
       s++;
-      *wr = s;
-      wr++;
+      aml_pool_vec_push_value(&v, char *, s);
     } else
       s++;
   }
-  *wr = NULL;
-  return r;
+  if (num_splits)
+    *num_splits = v.size;
+  aml_pool_vec_push_value(&v, char *, NULL);
+  return (char **)aml_pool_vec_shrink_to_fit(&v);
 }
 
 char **aml_pool_split(aml_pool_t *h, size_t *num_splits, char delim,
@@ -386,6 +1466,79 @@ char **aml_pool_splitf(aml_pool_t *h, size_t *num_splits, char delim,
   return _aml_pool_split(h, num_splits, delim, r);
 }
 
+/* The interned strings live in a pool of their own, which gets its memory
+   the same way that h gets its blocks. */
+static aml_pool_t *_aml_pool_intern_pool_init(aml_pool_t *h, size_t size) {
+  if (h->fixed)
+    abort();
+  /* from the pool h came from, so that restoring h doesn't release it and
+     it goes away with that pool */
+  if (h->pool)
+    return aml_pool_pool_init(h->pool, size);
+  if (h->backing)
+    return aml_pool_init_ex(size, h->backing);
+  if (!h->guard && !h->numa && !h->pages)
+    return aml_pool_init(size);
+
+  /* like hugepage pools, the real first block is mapped separately */
+  aml_pool_t *r = aml_pool_init(sizeof(size_t));
+  r->guard = h->guard;
+  r->pages = h->pages;
+  if (h->numa) {
+    r->numa = (struct aml_pool_numa_s *)aml_malloc(sizeof(*h->numa));
+    if (!r->numa)
+      abort();
+    memcpy(r->numa, h->numa, sizeof(*h->numa));
+  }
+  r->current = _aml_pool_block_alloc(r, size);
+  r->current->prev = NULL;
+  _aml_pool_rewind(r);
+  r->max_used = 0;
+  aml_pool_set_minimum_growth_size(r, size);
+  return r;
+}
+
+const char *aml_pool_intern(aml_pool_t *h, const char *s, size_t len) {
+  if (!h->intern) {
+    if (!h->intern_pool)
+      h->intern_pool = _aml_pool_intern_pool_init(h, 16384);
+    h->intern = aml_pool_map_str_init(h->intern_pool, 0);
+  }
+  return aml_pool_map_str_key(aml_pool_map_str_insert(h->intern, s, len, NULL));
+}
+
+size_t aml_pool_interned(aml_pool_t *h) {
+  return h->intern ? aml_pool_map_size(h->intern) : 0;
+}
+
+const char **aml_pool_split_intern(aml_pool_t *h, size_t *num_splits,
+                                   char delim, const char *s) {
+  static const char *nil = NULL;
+  if (!s) {
+    if (num_splits)
+      *num_splits = 0;
+    return &nil;
+  }
+  /* the interned strings live in a side pool, so nothing else is allocated
+     from h while the vector grows */
+  aml_pool_vec_t v;
+  aml_pool_vec_init(&v, h, sizeof(char *), 0);
+  const char *start = s;
+  for (;; s++) {
+    if (*s == delim || !*s) {
+      aml_pool_vec_push_value(&v, const char *,
+                              aml_pool_intern(h, start, s - start));
+      if (!*s)
+        break;
+      start = s + 1;
+    }
+  }
+  if (num_splits)
+    *num_splits = v.size;
+  aml_pool_vec_push_value(&v, const char *, NULL);
+  return (const char **)aml_pool_vec_shrink_to_fit(&v);
+}
+
 char **_aml_pool_split2(aml_pool_t *h, size_t *num_splits, char delim, char *s) {
   size_t num_res = 0;
   char **res = _aml_pool_split(h, &num_res, delim, s);
@@ -428,32 +1581,14 @@ char **_aml_pool_split_with_escape(aml_pool_t *h, size_t *num_splits, char delim
     // Duplicate the string into the pool for modification
     char *s = aml_pool_strdup(h, p);
     char *current = s;
-    size_t count = 1; // At least one split by default
     int escape_next = 0; // Flag to handle escape sequences
 
-    // First pass: Count splits while handling escape characters
-    for (char *c = s; *c; ++c) {
-        if (escape_next) {
-            escape_next = 0; // Skip this character; it was escaped
-            continue;
-        }
-        if (*c == escape) {
-            escape_next = 1; // Escape the next character
-            continue;
-        }
-        if (*c == delim) {
-            ++count;
-        }
-    }
-
-    // Allocate memory for the result array
-    char **result = (char **)aml_pool_alloc(h, sizeof(char *) * (count + 1));
-
-    size_t idx = 0;
-    result[idx++] = current; // First segment starts at the beginning
-    escape_next = 0;
+    // The copy is the last allocation, so the result grows in place after it
+    aml_pool_vec_t result;
+    aml_pool_vec_init(&result, h, sizeof(char *), 0);
+    aml_pool_vec_push_value(&result, char *, current); // First segment starts at the beginning
 
-    // Second pass: Split the string while removing escape characters
+    // Split the string while removing escape characters
     for (char *c = s; *c; ++c) {
         if (escape_next) {
             escape_next = 0; // Keep the escaped character
@@ -466,20 +1601,20 @@ char **_aml_pool_split_with_escape(aml_pool_t *h, size_t *num_splits, char delim
         }
         if (*c == delim) {
             *current++ = '\0'; // Terminate the current segment
-            result[idx++] = current; // Start a new segment
+            aml_pool_vec_push_value(&result, char *, current); // Start a new segment
             continue;
         }
         *current++ = *c; // Copy character
     }
 
     *current = '\0'; // Null-terminate the final segment
-    result[idx] = NULL; // Null-terminate the result array
 
     if (num_splits) {
-        *num_splits = idx;
+        *num_splits = result.size;
     }
 
-    return result;
+    aml_pool_vec_push_value(&result, char *, NULL); // Null-terminate the result array
+    return (char **)aml_pool_vec_shrink_to_fit(&result);
 }
 
 char **aml_pool_split_with_escape(aml_pool_t *h, size_t *num_splits, char delim, char escape,
@@ -782,7 +1917,8 @@ char *aml_pool_escape_tsvf(aml_pool_t *pool, const char *fmt, ...) {
 // INTERNAL DELIMITED PARSING CORES
 // =============================================================================
 
-static char **_aml_pool_split_delim(aml_pool_t *h, size_t *num_splits, const char *s, char delim) {
+static char **_aml_pool_split_delim(aml_pool_t *h, size_t *num_splits, const char *s, char delim,
+                                    bool intern) {
     if (!s) {
         if (num_splits) *num_splits = 0;
         static char *nil = NULL;
@@ -831,6 +1967,13 @@ static char **_aml_pool_split_delim(aml_pool_t *h, size_t *num_splits, const cha
     *write_ptr = '\0';
     result[idx] = NULL;
 
+    if (intern) {
+        /* the unescaped fields are only needed until they are interned */
+        for (size_t i = 0; i < idx; i++)
+            result[i] = (char *)aml_pool_intern(h, result[i], strlen(result[i]));
+        aml_pool_pop(h, buffer, slen + 1);
+    }
+
     if (num_splits) *num_splits = idx;
     return result;
 }
@@ -912,11 +2055,21 @@ static char *_aml_pool_join_delim(aml_pool_t *pool, char **fields, size_t num_fi
 // =============================================================================
 
 char **aml_pool_split_csv(aml_pool_t *pool, size_t *num_splits, const char *s) {
-    return _aml_pool_split_delim(pool, num_splits, s, ',');
+    return _aml_pool_split_delim(pool, num_splits, s, ',', false);
 }
 
 char **aml_pool_split_tsv(aml_pool_t *pool, size_t *num_splits, const char *s) {
-    return _aml_pool_split_delim(pool, num_splits, s, '\t');
+    return _aml_pool_split_delim(pool, num_splits, s, '\t', false);
+}
+
+const char **aml_pool_split_csv_intern(aml_pool_t *pool, size_t *num_splits,
+                                       const char *s) {
+    return (const char **)_aml_pool_split_delim(pool, num_splits, s, ',', true);
+}
+
+const char **aml_pool_split_tsv_intern(aml_pool_t *pool, size_t *num_splits,
+                                       const char *s) {
+    return (const char **)_aml_pool_split_delim(pool, num_splits, s, '\t', true);
 }
 
 char *aml_pool_join_csv(aml_pool_t *pool, char **fields, size_t num_fields) {
@@ -0,0 +1,204 @@
+// SPDX-FileCopyrightText: 2019–2026 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai
+// SPDX-License-Identifier: Apache-2.0
+//
+// Maintainer: Andy Curtis <contactandyc@gmail.com>
+
+#include "a-memory-library/aml_pool_depot.h"
+#include "a-memory-library/aml_alloc.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define DEPOT_MIN_SHIFT 12
+#define DEPOT_MAX_SHIFT 26
+#define DEPOT_CLASSES (DEPOT_MAX_SHIFT - DEPOT_MIN_SHIFT + 1)
+
+/* a thread holds at most this many blocks per class before half of them are
+   moved to the global stack */
+#define DEPOT_MAGAZINE_SIZE 8
+
+/* cached blocks are linked through their first word */
+typedef struct depot_block_s {
+  struct depot_block_s *next;
+} depot_block_t;
+
+typedef struct {
+  depot_block_t *head[DEPOT_CLASSES];
+  uint32_t count[DEPOT_CLASSES];
+  bool registered;
+} depot_magazine_t;
+
+/* The global stacks are only pushed to with a compare and swap and are only
+   emptied with an exchange, which avoids the ABA problem that popping single
+   blocks with a compare and swap would have. */
+static depot_block_t *global_stack[DEPOT_CLASSES];
+
+static size_t max_cached_bytes = 0;
+static size_t cached_bytes = 0;
+static size_t hits = 0;
+static size_t misses = 0;
+static size_t overflows = 0;
+
+static __thread depot_magazine_t magazine;
+static pthread_key_t magazine_key;
+static pthread_once_t magazine_once = PTHREAD_ONCE_INIT;
+
+static void depot_push_chain(int cls, depot_block_t *first,
+                             depot_block_t *last) {
+  depot_block_t *head = __atomic_load_n(&global_stack[cls], __ATOMIC_RELAXED);
+  do {
+    last->next = head;
+  } while (!__atomic_compare_exchange_n(&global_stack[cls], &head, first, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/* moves count blocks from the front of the magazine to the global stack */
+static void depot_flush(depot_magazine_t *m, int cls, uint32_t count) {
+  if (!count)
+    return;
+  depot_block_t *first = m->head[cls];
+  depot_block_t *last = first;
+  for (uint32_t i = 1; i < count; i++)
+    last = last->next;
+  m->head[cls] = last->next;
+  m->count[cls] -= count;
+  depot_push_chain(cls, first, last);
+}
+
+static void magazine_destroy(void *p) {
+  depot_magazine_t *m = (depot_magazine_t *)p;
+  for (int cls = 0; cls < DEPOT_CLASSES; cls++)
+    depot_flush(m, cls, m->count[cls]);
+  m->registered = false;
+}
+
+static void magazine_key_init(void) {
+  if (pthread_key_create(&magazine_key, magazine_destroy))
+    abort();
+}
+
+/* the key only exists so that a thread's blocks go back to the global stacks
+   when it exits */
+static void magazine_register(depot_magazine_t *m) {
+  if (m->registered)
+    return;
+  pthread_once(&magazine_once, magazine_key_init);
+  pthread_setspecific(magazine_key, m);
+  m->registered = true;
+}
+
+/* takes up to half a magazine from the global stack and puts the rest back */
+static void depot_refill(depot_magazine_t *m, int cls) {
+  if (!__atomic_load_n(&global_stack[cls], __ATOMIC_RELAXED))
+    return;
+  depot_block_t *chain =
+      __atomic_exchange_n(&global_stack[cls], NULL, __ATOMIC_ACQUIRE);
+  if (!chain)
+    return;
+  magazine_register(m);
+  depot_block_t *last = chain;
+  uint32_t taken = 1;
+  while (last->next && taken < DEPOT_MAGAZINE_SIZE / 2) {
+    last = last->next;
+    taken++;
+  }
+  depot_block_t *rest = last->next;
+  last->next = m->head[cls];
+  m->head[cls] = chain;
+  m->count[cls] += taken;
+  if (rest) {
+    depot_block_t *tail = rest;
+    while (tail->next)
+      tail = tail->next;
+    depot_push_chain(cls, rest, tail);
+  }
+}
+
+static int depot_class(size_t len) {
+  if (len <= ((size_t)1 << DEPOT_MIN_SHIFT))
+    return 0;
+  int shift = 64 - __builtin_clzll((unsigned long long)(len - 1));
+  if (shift > DEPOT_MAX_SHIFT)
+    return -1;
+  return shift - DEPOT_MIN_SHIFT;
+}
+
+void aml_pool_depot_enable(size_t max_bytes) {
+  __atomic_store_n(&max_cached_bytes, max_bytes, __ATOMIC_RELAXED);
+}
+
+void aml_pool_depot_stats(aml_pool_depot_stats_t *stats) {
+  stats->hits = __atomic_load_n(&hits, __ATOMIC_RELAXED);
+  stats->misses = __atomic_load_n(&misses, __ATOMIC_RELAXED);
+  stats->overflows = __atomic_load_n(&overflows, __ATOMIC_RELAXED);
+  stats->cached_bytes = __atomic_load_n(&cached_bytes, __ATOMIC_RELAXED);
+  stats->max_cached_bytes = __atomic_load_n(&max_cached_bytes, __ATOMIC_RELAXED);
+}
+
+void aml_pool_depot_trim(void) {
+  depot_magazine_t *m = &magazine;
+  for (int cls = 0; cls < DEPOT_CLASSES; cls++) {
+    size_t size = (size_t)1 << (cls + DEPOT_MIN_SHIFT);
+    depot_flush(m, cls, m->count[cls]);
+    depot_block_t *block =
+        __atomic_exchange_n(&global_stack[cls], NULL, __ATOMIC_ACQUIRE);
+    while (block) {
+      depot_block_t *next = block->next;
+      aml_free(block);
+      __atomic_sub_fetch(&cached_bytes, size, __ATOMIC_RELAXED);
+      block = next;
+    }
+  }
+}
+
+void *aml_pool_depot_alloc(size_t *len) {
+  if (!__atomic_load_n(&max_cached_bytes, __ATOMIC_RELAXED))
+    return NULL;
+  int cls = depot_class(*len);
+  if (cls < 0)
+    return NULL;
+  size_t size = (size_t)1 << (cls + DEPOT_MIN_SHIFT);
+  *len = size;
+
+  depot_magazine_t *m = &magazine;
+  if (!m->head[cls])
+    depot_refill(m, cls);
+  depot_block_t *block = m->head[cls];
+  if (block) {
+    m->head[cls] = block->next;
+    m->count[cls]--;
+    __atomic_sub_fetch(&cached_bytes, size, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&hits, 1, __ATOMIC_RELAXED);
+    return block;
+  }
+  __atomic_add_fetch(&misses, 1, __ATOMIC_RELAXED);
+  block = (depot_block_t *)aml_malloc(size);
+  if (!block)
+    abort();
+  return block;
+}
+
+bool aml_pool_depot_release(void *p, size_t len) {
+  size_t max_bytes = __atomic_load_n(&max_cached_bytes, __ATOMIC_RELAXED);
+  if (!max_bytes)
+    return false;
+  if ((len & (len - 1)) || len < ((size_t)1 << DEPOT_MIN_SHIFT) ||
+      len > ((size_t)1 << DEPOT_MAX_SHIFT))
+    return false;
+  if (__atomic_add_fetch(&cached_bytes, len, __ATOMIC_RELAXED) > max_bytes) {
+    __atomic_sub_fetch(&cached_bytes, len, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&overflows, 1, __ATOMIC_RELAXED);
+    return false;
+  }
+  int cls = __builtin_ctzll((unsigned long long)len) - DEPOT_MIN_SHIFT;
+  depot_magazine_t *m = &magazine;
+  magazine_register(m);
+  depot_block_t *block = (depot_block_t *)p;
+  block->next = m->head[cls];
+  m->head[cls] = block;
+  m->count[cls]++;
+  if (m->count[cls] > DEPOT_MAGAZINE_SIZE)
+    depot_flush(m, cls, DEPOT_MAGAZINE_SIZE / 2);
+  return true;
+}
@@ -0,0 +1,327 @@
+// SPDX-FileCopyrightText: 2019–2026 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai
+// SPDX-License-Identifier: Apache-2.0
+//
+// Maintainer: Andy Curtis <contactandyc@gmail.com>
+
+#include "a-memory-library/aml_pool_map.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define MAP_GROUP 16
+#define MAP_MIN_CAPACITY 16
+#define MAP_EMPTY 0x80
+
+/* A string map's slots only point at its entries, which hold the key and
+   the value together in the pool, so a lookup touches one cache line beyond
+   the table.  An entry never moves once added. */
+typedef struct {
+  uint64_t hash;
+  size_t len;
+  void *value;
+  char key[];
+} map_str_entry_t;
+
+typedef struct {
+  uint64_t key;
+  void *value;
+} map_int_slot_t;
+
+struct aml_pool_map_s {
+  aml_pool_t *pool;
+  /* capacity + MAP_GROUP control bytes, the first MAP_GROUP are repeated at
+     the end so that a group can be loaded from any slot */
+  uint8_t *ctrl;
+  /* map_str_entry_t * or map_int_slot_t */
+  void *slots;
+  size_t mask;
+  size_t size;
+  /* inserts left before the table is 7/8 full */
+  size_t growth_left;
+  bool str_keys;
+};
+
+static inline uint64_t map_mix(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+static uint64_t map_hash_str(const char *key, size_t len) {
+  uint64_t h = 0x9e3779b97f4a7c15ULL ^ len;
+  uint64_t w;
+  while (len >= 8) {
+    memcpy(&w, key, 8);
+    h = (h ^ w) * 0x100000001b3ULL;
+    h = (h << 29) | (h >> 35);
+    key += 8;
+    len -= 8;
+  }
+  w = 0;
+  if (len)
+    memcpy(&w, key, len);
+  h = (h ^ w) * 0x100000001b3ULL;
+  return map_mix(h);
+}
+
+/* bit i is set when ctrl[i] of the group equals b */
+static inline uint32_t map_match(const uint8_t *g, uint8_t b) {
+#ifdef __SSE2__
+  __m128i ctrl = _mm_loadu_si128((const __m128i *)g);
+  return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)b)));
+#else
+  uint32_t r = 0;
+  for (int i = 0; i < MAP_GROUP; i++)
+    r |= (uint32_t)(g[i] == b) << i;
+  return r;
+#endif
+}
+
+/* only empty control bytes have the high bit set */
+static inline uint32_t map_match_empty(const uint8_t *g) {
+#ifdef __SSE2__
+  return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)g));
+#else
+  return map_match(g, MAP_EMPTY);
+#endif
+}
+
+static void map_alloc_table(aml_pool_map_t *m, size_t capacity) {
+  m->ctrl = (uint8_t *)aml_pool_alloc(m->pool, capacity + MAP_GROUP);
+  memset(m->ctrl, MAP_EMPTY, capacity + MAP_GROUP);
+  m->slots = aml_pool_alloc_array(m->pool, capacity,
+                                  m->str_keys ? sizeof(map_str_entry_t *)
+                                              : sizeof(map_int_slot_t));
+  m->mask = capacity - 1;
+  m->growth_left = capacity - capacity / 8 - m->size;
+}
+
+static aml_pool_map_t *map_init(aml_pool_t *pool, size_t size_hint,
+                                bool str_keys) {
+  aml_pool_map_t *m = (aml_pool_map_t *)aml_pool_zalloc(pool, sizeof(*m));
+  m->pool = pool;
+  m->str_keys = str_keys;
+  size_t capacity = MAP_MIN_CAPACITY;
+  while (capacity - capacity / 8 < size_hint) {
+    if (capacity > SIZE_MAX / 4)
+      abort();
+    capacity <<= 1;
+  }
+  map_alloc_table(m, capacity);
+  return m;
+}
+
+aml_pool_map_t *aml_pool_map_str_init(aml_pool_t *pool, size_t size_hint) {
+  return map_init(pool, size_hint, true);
+}
+
+aml_pool_map_t *aml_pool_map_int_init(aml_pool_t *pool, size_t size_hint) {
+  return map_init(pool, size_hint, false);
+}
+
+size_t aml_pool_map_size(const aml_pool_map_t *m) { return m->size; }
+
+static inline void map_set_ctrl(aml_pool_map_t *m, size_t i, uint8_t h2) {
+  m->ctrl[i] = h2;
+  if (i < MAP_GROUP)
+    m->ctrl[m->mask + 1 + i] = h2;
+}
+
+/* the first empty slot on hash's probe sequence */
+static size_t map_find_empty(const aml_pool_map_t *m, uint64_t hash) {
+  size_t pos = (size_t)(hash >> 7) & m->mask;
+  size_t step = 0;
+  for (;;) {
+    uint32_t empty = map_match_empty(m->ctrl + pos);
+    if (empty)
+      return (pos + (size_t)__builtin_ctz(empty)) & m->mask;
+    step += MAP_GROUP;
+    pos = (pos + step) & m->mask;
+  }
+}
+
+static void map_rehash(aml_pool_map_t *m) {
+  uint8_t *old_ctrl = m->ctrl;
+  void *old_slots = m->slots;
+  size_t old_capacity = m->mask + 1;
+  if (old_capacity > SIZE_MAX / 4)
+    abort();
+  map_alloc_table(m, old_capacity * 2);
+  for (size_t i = 0; i < old_capacity; i++) {
+    if (old_ctrl[i] & MAP_EMPTY)
+      continue;
+    uint64_t hash;
+    size_t j;
+    if (m->str_keys) {
+      map_str_entry_t *e = ((map_str_entry_t **)old_slots)[i];
+      hash = e->hash;
+      j = map_find_empty(m, hash);
+      ((map_str_entry_t **)m->slots)[j] = e;
+    } else {
+      map_int_slot_t *s = (map_int_slot_t *)old_slots + i;
+      hash = map_mix(s->key);
+      j = map_find_empty(m, hash);
+      ((map_int_slot_t *)m->slots)[j] = *s;
+    }
+    map_set_ctrl(m, j, (uint8_t)(hash & 0x7f));
+  }
+}
+
+/* claims the empty slot for a new key and returns its index */
+static size_t map_add(aml_pool_map_t *m, uint64_t hash) {
+  if (!m->growth_left)
+    map_rehash(m);
+  size_t i = map_find_empty(m, hash);
+  map_set_ctrl(m, i, (uint8_t)(hash & 0x7f));
+  m->size++;
+  m->growth_left--;
+  return i;
+}
+
+static map_str_entry_t *map_str_lookup(const aml_pool_map_t *m, uint64_t hash,
+                                       const char *key, size_t len) {
+  if (!m->str_keys)
+    abort();
+  map_str_entry_t **slots = (map_str_entry_t **)m->slots;
+  uint8_t h2 = (uint8_t)(hash & 0x7f);
+  size_t pos = (size_t)(hash >> 7) & m->mask;
+  size_t step = 0;
+  /* the slot load would otherwise wait for the control bytes */
+  __builtin_prefetch(slots + pos);
+  for (;;) {
+    const uint8_t *g = m->ctrl + pos;
+    for (uint32_t match = map_match(g, h2); match; match &= match - 1) {
+      map_str_entry_t *e = slots[(pos + (size_t)__builtin_ctz(match)) & m->mask];
+      if (e->hash == hash && e->len == len && (!len || !memcmp(e->key, key, len)))
+        return e;
+    }
+    if (map_match_empty(g))
+      return NULL;
+    step += MAP_GROUP;
+    pos = (pos + step) & m->mask;
+  }
+}
+
+static map_int_slot_t *map_int_lookup(const aml_pool_map_t *m, uint64_t hash,
+                                      uint64_t key) {
+  if (m->str_keys)
+    abort();
+  map_int_slot_t *slots = (map_int_slot_t *)m->slots;
+  uint8_t h2 = (uint8_t)(hash & 0x7f);
+  size_t pos = (size_t)(hash >> 7) & m->mask;
+  size_t step = 0;
+  __builtin_prefetch(slots + pos);
+  for (;;) {
+    const uint8_t *g = m->ctrl + pos;
+    for (uint32_t match = map_match(g, h2); match; match &= match - 1) {
+      map_int_slot_t *s = slots + ((pos + (size_t)__builtin_ctz(match)) & m->mask);
+      if (s->key == key)
+        return s;
+    }
+    if (map_match_empty(g))
+      return NULL;
+    step += MAP_GROUP;
+    pos = (pos + step) & m->mask;
+  }
+}
+
+void **aml_pool_map_str_find(const aml_pool_map_t *m, const char *key,
+                             size_t len) {
+  map_str_entry_t *e = map_str_lookup(m, map_hash_str(key, len), key, len);
+  return e ? &e->value : NULL;
+}
+
+void **aml_pool_map_str_insert(aml_pool_map_t *m, const char *key, size_t len,
+                               bool *inserted) {
+  uint64_t hash = map_hash_str(key, len);
+  map_str_entry_t *e = map_str_lookup(m, hash, key, len);
+  if (inserted)
+    *inserted = !e;
+  if (e)
+    return &e->value;
+  if (len > SIZE_MAX - sizeof(map_str_entry_t) - 1)
+    abort();
+  e = (map_str_entry_t *)aml_pool_alloc(m->pool, sizeof(*e) + len + 1);
+  e->hash = hash;
+  e->len = len;
+  e->value = NULL;
+  if (len)
+    memcpy(e->key, key, len);
+  e->key[len] = 0;
+  size_t i = map_add(m, hash);
+  ((map_str_entry_t **)m->slots)[i] = e;
+  return &e->value;
+}
+
+const char *aml_pool_map_str_key(void **value) {
+  return ((map_str_entry_t *)((char *)value - offsetof(map_str_entry_t, value)))
+      ->key;
+}
+
+void **aml_pool_map_int_find(const aml_pool_map_t *m, uint64_t key) {
+  map_int_slot_t *s = map_int_lookup(m, map_mix(key), key);
+  return s ? &s->value : NULL;
+}
+
+void **aml_pool_map_int_insert(aml_pool_map_t *m, uint64_t key,
+                               bool *inserted) {
+  uint64_t hash = map_mix(key);
+  map_int_slot_t *s = map_int_lookup(m, hash, key);
+  if (inserted)
+    *inserted = !s;
+  if (s)
+    return &s->value;
+  size_t i = map_add(m, hash);
+  s = (map_int_slot_t *)m->slots + i;
+  s->key = key;
+  s->value = NULL;
+  return &s->value;
+}
+
+/* the next full slot at or after *pos */
+static bool map_next_slot(const aml_pool_map_t *m, size_t *pos) {
+  while (*pos <= m->mask) {
+    if (!(m->ctrl[*pos] & MAP_EMPTY))
+      return true;
+    (*pos)++;
+  }
+  return false;
+}
+
+bool aml_pool_map_str_next(const aml_pool_map_t *m, size_t *pos,
+                           const char **key, size_t *len, void **value) {
+  if (!m->str_keys)
+    abort();
+  if (!map_next_slot(m, pos))
+    return false;
+  const map_str_entry_t *e = ((map_str_entry_t **)m->slots)[*pos];
+  (*pos)++;
+  *key = e->key;
+  if (len)
+    *len = e->len;
+  if (value)
+    *value = e->value;
+  return true;
+}
+
+bool aml_pool_map_int_next(const aml_pool_map_t *m, size_t *pos,
+                           uint64_t *key, void **value) {
+  if (m->str_keys)
+    abort();
+  if (!map_next_slot(m, pos))
+    return false;
+  const map_int_slot_t *s = (map_int_slot_t *)m->slots + *pos;
+  (*pos)++;
+  *key = s->key;
+  if (value)
+    *value = s->value;
+  return true;
+}
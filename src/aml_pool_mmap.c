@@ -0,0 +1,161 @@
+// SPDX-FileCopyrightText: 2019–2026 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai
+// SPDX-License-Identifier: Apache-2.0
+//
+// Maintainer: Andy Curtis <contactandyc@gmail.com>
+
+#include "a-memory-library/aml_pool_mmap.h"
+#include "a-memory-library/aml_alloc.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define AML_POOL_MMAP_MAGIC 0x31706d6d6c6f6f70ULL /* "poolmmp1" */
+
+/* the first bytes of the file, followed by the pool header and its block */
+typedef struct {
+  uint64_t magic;
+  /* bytes of the file in use as of the last sync (0 if never synced) */
+  uint64_t length;
+  /* offset of the root from the start of the file (0 if none) */
+  uint64_t root;
+  uint64_t reserved;
+} aml_pool_mmap_header_t;
+
+/* The backing allocator must be the first member so that the pool's backing
+   pointer leads back to the rest of the state. */
+typedef struct {
+  aml_backing_allocator_t backing;
+  char *base;
+  size_t reserve;
+  int fd;
+  bool first;
+} aml_pool_mmap_t;
+
+/* The pool header and its only block are the one allocation made from the
+   mapping.  Growth fails, which makes the pool abort. */
+static void *mmap_alloc(void *ctx, size_t len) {
+  aml_pool_mmap_t *m = (aml_pool_mmap_t *)ctx;
+  if (m->first || len > m->reserve - sizeof(aml_pool_mmap_header_t))
+    return NULL;
+  m->first = true;
+  return m->base + sizeof(aml_pool_mmap_header_t);
+}
+
+/* only called by aml_pool_destroy for the pool header */
+static void mmap_free(void *ctx, void *p, size_t len) {
+  (void)p;
+  (void)len;
+  aml_pool_mmap_t *m = (aml_pool_mmap_t *)ctx;
+  aml_pool_mmap_header_t *header = (aml_pool_mmap_header_t *)m->base;
+  size_t length = header->length ? header->length : sizeof(*header);
+  munmap(m->base, m->reserve);
+  /* if this fails the file keeps its sparse reserved length, which readers
+     accept */
+  int r = ftruncate(m->fd, (off_t)length);
+  (void)r;
+  close(m->fd);
+  aml_free(m);
+}
+
+static aml_pool_mmap_t *_aml_pool_mmap(aml_pool_t *h) {
+  if (!h->backing || h->backing->alloc != mmap_alloc)
+    abort(); /* not a file-backed pool */
+  return (aml_pool_mmap_t *)h->backing->ctx;
+}
+
+aml_pool_t *aml_pool_mmap_init(const char *path, size_t reserve) {
+  size_t overhead = sizeof(aml_pool_mmap_header_t) + sizeof(aml_pool_t) +
+                    sizeof(aml_pool_node_t);
+  if (reserve < overhead + 64)
+    return NULL;
+
+  int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return NULL;
+  if (ftruncate(fd, (off_t)reserve) != 0) {
+    close(fd);
+    return NULL;
+  }
+  char *base = (char *)mmap(NULL, reserve, PROT_READ | PROT_WRITE, MAP_SHARED,
+                            fd, 0);
+  if (base == MAP_FAILED) {
+    close(fd);
+    return NULL;
+  }
+
+  aml_pool_mmap_header_t *header = (aml_pool_mmap_header_t *)base;
+  memset(header, 0, sizeof(*header));
+  header->magic = AML_POOL_MMAP_MAGIC;
+
+  aml_pool_mmap_t *m = (aml_pool_mmap_t *)aml_malloc(sizeof(aml_pool_mmap_t));
+  if (!m)
+    abort();
+  m->backing.alloc = mmap_alloc;
+  m->backing.free = mmap_free;
+  m->backing.realloc = NULL;
+  m->backing.ctx = m;
+  m->base = base;
+  m->reserve = reserve;
+  m->fd = fd;
+  m->first = false;
+
+  /* the block takes the rest of the reservation */
+  size_t block_size = (reserve - overhead) & ~(sizeof(size_t) - 1);
+  return aml_pool_init_ex(block_size, &m->backing);
+}
+
+void aml_pool_mmap_set_root(aml_pool_t *h, const void *p) {
+  aml_pool_mmap_t *m = _aml_pool_mmap(h);
+  aml_pool_mmap_header_t *header = (aml_pool_mmap_header_t *)m->base;
+  header->root = p ? aml_pool_mmap_offset(h, p) : 0;
+}
+
+bool aml_pool_mmap_sync(aml_pool_t *h) {
+  aml_pool_mmap_t *m = _aml_pool_mmap(h);
+  aml_pool_mmap_header_t *header = (aml_pool_mmap_header_t *)m->base;
+  header->length = (uint64_t)(h->curp - m->base);
+  return msync(m->base, header->length, MS_SYNC) == 0;
+}
+
+size_t aml_pool_mmap_offset(aml_pool_t *h, const void *p) {
+  aml_pool_mmap_t *m = _aml_pool_mmap(h);
+  if ((const char *)p < m->base || (const char *)p >= m->base + m->reserve)
+    abort(); /* not in the file */
+  return (size_t)((const char *)p - m->base);
+}
+
+bool aml_pool_mmap_open(aml_pool_mmap_view_t *view, const char *path) {
+  memset(view, 0, sizeof(*view));
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+  /* only the part of the file recorded by the last sync is mapped */
+  aml_pool_mmap_header_t header;
+  struct stat st;
+  if (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+      fstat(fd, &st) != 0 || header.magic != AML_POOL_MMAP_MAGIC ||
+      header.length < sizeof(header) || header.length > (uint64_t)st.st_size ||
+      header.root >= header.length) {
+    close(fd);
+    return false;
+  }
+  char *base = (char *)mmap(NULL, header.length, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    return false;
+  view->base = base;
+  view->length = (size_t)header.length;
+  view->root = header.root ? base + header.root : NULL;
+  return true;
+}
+
+void aml_pool_mmap_close(aml_pool_mmap_view_t *view) {
+  if (view->base)
+    munmap((void *)view->base, view->length);
+  memset(view, 0, sizeof(*view));
+}
@@ -0,0 +1,59 @@
+// SPDX-FileCopyrightText: 2019–2026 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai
+// SPDX-License-Identifier: Apache-2.0
+//
+// Maintainer: Andy Curtis <contactandyc@gmail.com>
+
+#include "a-memory-library/aml_pool_vec.h"
+
+#define VEC_MIN_CAPACITY 8
+
+void aml_pool_vec_init(aml_pool_vec_t *v, aml_pool_t *pool, size_t elem_size,
+                       size_t capacity) {
+  if (!elem_size)
+    abort();
+  v->pool = pool;
+  v->data = NULL;
+  v->size = 0;
+  v->capacity = 0;
+  v->elem_size = elem_size;
+  if (capacity)
+    aml_pool_vec_reserve(v, capacity);
+}
+
+/* realloc_last extends the array in place when it ends at the top of the
+   current block and copies it otherwise */
+static void vec_resize(aml_pool_vec_t *v, size_t capacity) {
+  if (capacity > SIZE_MAX / v->elem_size)
+    abort();
+  v->data = (char *)aml_pool_realloc_last(v->pool, v->data,
+                                          v->capacity * v->elem_size,
+                                          capacity * v->elem_size);
+  v->capacity = capacity;
+}
+
+void _aml_pool_vec_grow(aml_pool_vec_t *v, size_t min_capacity) {
+  size_t capacity = v->capacity ? v->capacity : VEC_MIN_CAPACITY / 2;
+  if (capacity > SIZE_MAX / 2)
+    abort();
+  capacity *= 2;
+  if (capacity < min_capacity)
+    capacity = min_capacity;
+  vec_resize(v, capacity);
+}
+
+void aml_pool_vec_reserve(aml_pool_vec_t *v, size_t capacity) {
+  if (capacity > v->capacity)
+    vec_resize(v, capacity);
+}
+
+void *aml_pool_vec_shrink_to_fit(aml_pool_vec_t *v) {
+  /* the unused capacity is popped as if it were its own allocation, which
+     only works while nothing has been allocated after the vector */
+  char *end = v->data + v->capacity * v->elem_size;
+  if (v->size < v->capacity && end == v->pool->curp &&
+      aml_pool_pop(v->pool, v->data + v->size * v->elem_size,
+                   (v->capacity - v->size) * v->elem_size))
+    v->capacity = v->size;
+  return v->data;
+}
@@ -11,6 +11,7 @@
 #include "a-memory-library/aml_alloc.h"
 
 #include <string.h>
+#include <stdlib.h>
 #include <stdarg.h>
 #include <stdint.h>
 
@@ -229,6 +230,84 @@ MACRO_TEST(buffer_append_binary_with_nulls) {
     aml_buffer_destroy(b);
 }
 
+typedef struct {
+    size_t allocs;
+    size_t frees;
+    size_t reallocs;
+    size_t outstanding;
+} counting_ctx_t;
+
+static void *counting_alloc(void *ctx, size_t len) {
+    counting_ctx_t *c = (counting_ctx_t*)ctx;
+    c->allocs++;
+    c->outstanding += len;
+    return malloc(len);
+}
+
+static void counting_free(void *ctx, void *p, size_t len) {
+    counting_ctx_t *c = (counting_ctx_t*)ctx;
+    c->frees++;
+    c->outstanding -= len;
+    free(p);
+}
+
+static void *counting_realloc(void *ctx, void *p, size_t old_len, size_t new_len) {
+    counting_ctx_t *c = (counting_ctx_t*)ctx;
+    c->reallocs++;
+    c->outstanding += new_len - old_len;
+    return realloc(p, new_len);
+}
+
+MACRO_TEST(buffer_init_ex_uses_backing_allocator) {
+    // without realloc, growth allocates and frees through the allocator
+    counting_ctx_t c = {0, 0, 0, 0};
+    aml_backing_allocator_t a = { counting_alloc, counting_free, NULL, &c };
+    aml_buffer_t *b = aml_buffer_init_ex(4, &a);
+    for (int i = 0; i < 100; i++) aml_buffer_appends(b, "0123456789");
+    MACRO_ASSERT_EQ_SZ(aml_buffer_length(b), 1000);
+    MACRO_ASSERT_TRUE(c.allocs > 2);
+    aml_buffer_reset(b, 16);
+    aml_buffer_sets(b, "abc");
+    MACRO_ASSERT_STREQ(aml_buffer_data(b), "abc");
+    aml_buffer_destroy(b);
+    MACRO_ASSERT_EQ_SZ(c.allocs, c.frees);
+    MACRO_ASSERT_EQ_SZ(c.outstanding, 0);
+
+    // with realloc, growth resizes in place and detach hands back length + 1
+    counting_ctx_t r = {0, 0, 0, 0};
+    aml_backing_allocator_t ra = { counting_alloc, counting_free, counting_realloc, &r };
+    b = aml_buffer_init_ex(0, &ra);
+    for (int i = 0; i < 100; i++) aml_buffer_appends(b, "0123456789");
+    MACRO_ASSERT_TRUE(r.reallocs > 0);
+    size_t len = 0;
+    char *d = aml_buffer_detach(b, &len);
+    MACRO_ASSERT_EQ_SZ(len, 1000);
+    MACRO_ASSERT_TRUE(memcmp(d, "0123456789", 10) == 0);
+    ra.free(ra.ctx, d, len + 1);
+    aml_buffer_destroy(b);
+    MACRO_ASSERT_EQ_SZ(r.outstanding, 0);
+}
+
+MACRO_TEST(buffer_pool_backed_growth_extends_in_place) {
+    aml_pool_t *pool = aml_pool_init(1024 * 1024);
+    aml_buffer_t *b = aml_buffer_pool_init(pool, 8);
+    char *start = aml_buffer_data(b);
+    for (int i = 0; i < 10000; i++) aml_buffer_appends(b, "0123456789");
+    char *end = (char*)aml_pool_ualloc(pool, 1);
+    MACRO_ASSERT_EQ_SZ(aml_buffer_length(b), 100000);
+    MACRO_ASSERT_TRUE(memcmp(aml_buffer_data(b) + 99990, "0123456789", 10) == 0);
+    // growth reused the same region instead of leaving copies behind
+    MACRO_ASSERT_TRUE((size_t)(end - start) < 2 * 100000);
+
+    // once something else is allocated, growth falls back to copying
+    char *before = aml_buffer_data(b);
+    (void)aml_pool_alloc(pool, 16);
+    aml_buffer_resize(b, 200000);
+    MACRO_ASSERT_TRUE(aml_buffer_data(b) != before);
+    MACRO_ASSERT_TRUE(memcmp(aml_buffer_data(b), "0123456789", 10) == 0);
+    aml_pool_destroy(pool);
+}
+
 /* --- runner --- */
 int main(void) {
     macro_test_case tests[128];
@@ -250,6 +329,8 @@ int main(void) {
     MACRO_ADD(tests, buffer_grow_and_shrink_cycles);
     MACRO_ADD(tests, buffer_large_appends);
     MACRO_ADD(tests, buffer_append_binary_with_nulls);
+    MACRO_ADD(tests, buffer_init_ex_uses_backing_allocator);
+    MACRO_ADD(tests, buffer_pool_backed_growth_extends_in_place);
 
     macro_run_all("a-memory-library/aml_buffer", tests, test_count);
     return 0;
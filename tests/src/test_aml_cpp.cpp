@@ -0,0 +1,227 @@
+// SPDX-FileCopyrightText: 2019–2026 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai
+// SPDX-License-Identifier: Apache-2.0
+//
+// Maintainer: Andy Curtis <contactandyc@gmail.com>
+
+// test_aml_cpp.cpp
+#include "the-macro-library/macro_test.h"
+#include "a-memory-library/aml_pool.hpp"
+#include "a-memory-library/aml_buffer.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+/* counts calls to the global operator new so that the wrappers can be shown
+   not to allocate behind the pool's back */
+static size_t new_calls = 0;
+
+void *operator new(std::size_t n) {
+    new_calls++;
+    void *p = std::malloc(n ? n : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+typedef struct {
+    size_t allocs;
+    size_t frees;
+    size_t outstanding;
+} counting_ctx_t;
+
+static void *counting_alloc(void *ctx, size_t len) {
+    counting_ctx_t *c = (counting_ctx_t*)ctx;
+    c->allocs++;
+    c->outstanding += len;
+    return malloc(len);
+}
+
+static void counting_free(void *ctx, void *p, size_t len) {
+    counting_ctx_t *c = (counting_ctx_t*)ctx;
+    c->frees++;
+    c->outstanding -= len;
+    free(p);
+}
+
+static_assert(sizeof(aml::pool) == sizeof(aml_pool_t *));
+static_assert(sizeof(aml::buffer) == sizeof(aml_buffer_t *));
+static_assert(sizeof(aml::pool_allocator<int>) == sizeof(aml_pool_t *));
+
+typedef std::vector<int, aml::pool_allocator<int>> int_vector_t;
+
+MACRO_TEST(cpp_allocator_matches_c_calls) {
+    // raw C calls
+    counting_ctx_t c = {0, 0, 0};
+    aml_backing_allocator_t a = { counting_alloc, counting_free, NULL, &c };
+    aml_pool_t *raw = aml_pool_init_ex(1024, &a);
+    for (int i = 0; i < 100; i++) {
+        int *p = (int *)aml_pool_alloc(raw, 16 * sizeof(int));
+        p[0] = i;
+    }
+    size_t raw_used = aml_pool_used(raw);
+    aml_pool_destroy(raw);
+
+    // the same allocations through the wrappers
+    counting_ctx_t w = {0, 0, 0};
+    aml_backing_allocator_t wa = { counting_alloc, counting_free, NULL, &w };
+    size_t calls = new_calls;
+    {
+        aml::pool pool(aml_pool_init_ex(1024, &wa));
+        aml::pool_allocator<int> alloc(pool);
+        for (int i = 0; i < 100; i++) {
+            int *p = alloc.allocate(16);
+            p[0] = i;
+        }
+        MACRO_ASSERT_EQ_SZ(aml_pool_used(pool), raw_used);
+    }
+    MACRO_ASSERT_EQ_SZ(new_calls, calls);
+    MACRO_ASSERT_EQ_SZ(w.allocs, c.allocs);
+    MACRO_ASSERT_EQ_SZ(w.frees, c.frees);
+    MACRO_ASSERT_EQ_SZ(w.outstanding, 0);
+}
+
+MACRO_TEST(cpp_allocator_containers) {
+    aml::pool pool(4096);
+    size_t calls = new_calls;
+    int_vector_t v(pool);
+    v.reserve(64);
+    int *data = v.data();
+    for (int i = 0; i < 64; i++)
+        v.push_back(i);
+    MACRO_ASSERT_TRUE(v.data() == data);
+    MACRO_ASSERT_EQ_INT(v[63], 63);
+
+    typedef aml::pool_allocator<std::pair<const int, int>> pair_allocator_t;
+    std::map<int, int, std::less<int>, pair_allocator_t> m{pair_allocator_t(pool)};
+    for (int i = 0; i < 100; i++)
+        m[i] = i * 2;
+    MACRO_ASSERT_EQ_INT(m[50], 100);
+    MACRO_ASSERT_EQ_SZ(new_calls, calls);
+
+    // rebound copies share the pool
+    MACRO_ASSERT_TRUE(m.get_allocator() == v.get_allocator());
+    aml::pool other(1024);
+    MACRO_ASSERT_TRUE(aml::pool_allocator<int>(other) != v.get_allocator());
+
+    // the most recent allocation goes back to the pool
+    aml::pool_allocator<char> chars(pool);
+    char *top = chars.allocate(100);
+    chars.deallocate(top, 100);
+    MACRO_ASSERT_TRUE(chars.allocate(100) == top);
+
+    // freeing an older buffer while a small node after it is live does
+    // nothing
+    aml::pool_allocator<std::uint64_t> words(pool);
+    std::uint64_t *older = words.allocate(4);
+    char *node = chars.allocate(1);
+    *node = 'n';
+    words.deallocate(older, 4);
+    std::uint64_t *fresh = words.allocate(4);
+    MACRO_ASSERT_TRUE(reinterpret_cast<char *>(fresh) > node);
+    fresh[0] = fresh[1] = fresh[2] = fresh[3] = 0;
+    MACRO_ASSERT_TRUE(*node == 'n');
+
+    // over-aligned types
+    struct alignas(64) line_t { char bytes[64]; };
+    aml::pool_allocator<line_t> lines(pool);
+    (void)chars.allocate(3);
+    line_t *l = lines.allocate(2);
+    MACRO_ASSERT_EQ_SZ(reinterpret_cast<std::uintptr_t>(l) & 63, 0);
+}
+
+MACRO_TEST(cpp_pool_move_and_release) {
+    counting_ctx_t c = {0, 0, 0};
+    aml_backing_allocator_t a = { counting_alloc, counting_free, NULL, &c };
+    {
+        aml::pool p1(aml_pool_init_ex(1024, &a));
+        aml_pool_t *h = p1.get();
+        aml::pool p2(std::move(p1));
+        MACRO_ASSERT_TRUE(!p1);
+        MACRO_ASSERT_TRUE(p2.get() == h);
+        aml::pool p3(aml_pool_init_ex(1024, &a));
+        p3 = std::move(p2);  // destroys p3's pool
+        MACRO_ASSERT_TRUE(p3.get() == h);
+        MACRO_ASSERT_EQ_SZ(c.frees, 1);
+        MACRO_ASSERT_STREQ(aml_pool_strdup(p3, "hello"), "hello");
+    }
+    MACRO_ASSERT_EQ_SZ(c.allocs, c.frees);
+    MACRO_ASSERT_EQ_SZ(c.outstanding, 0);
+
+    aml::pool p(1024);
+    aml_pool_t *h = p.release();
+    MACRO_ASSERT_TRUE(!p);
+    aml_pool_destroy(h);
+}
+
+MACRO_TEST(cpp_pool_scope) {
+    aml::pool pool(1024);
+    aml_pool_strdup(pool, "keep");
+    size_t size = aml_pool_size(pool);
+    size_t used = aml_pool_used(pool);
+    {
+        aml::pool_scope scope(pool);
+        for (int i = 0; i < 100; i++)
+            aml_pool_alloc(pool, 100);
+        MACRO_ASSERT_TRUE(aml_pool_used(pool) > used);
+        aml::pool_scope inner(pool);
+        aml::pool_scope moved(std::move(inner));
+        aml_pool_alloc(pool, 10);
+    }
+    MACRO_ASSERT_EQ_SZ(aml_pool_size(pool), size);
+    MACRO_ASSERT_EQ_SZ(aml_pool_used(pool), used);
+}
+
+MACRO_TEST(cpp_buffer) {
+    counting_ctx_t c = {0, 0, 0};
+    aml_backing_allocator_t a = { counting_alloc, counting_free, NULL, &c };
+    size_t calls = new_calls;
+    {
+        aml::buffer bh(aml_buffer_init_ex(16, &a));
+        bh.append("hello");
+        bh.append(", world", 7);
+        aml_buffer_appendf(bh, " %d", 42);
+        MACRO_ASSERT_STREQ(bh.data(), "hello, world 42");
+        MACRO_ASSERT_EQ_SZ(bh.length(), 15);
+        aml::buffer moved(std::move(bh));
+        MACRO_ASSERT_TRUE(!bh);
+        MACRO_ASSERT_STREQ(moved.data(), "hello, world 42");
+        moved.clear();
+        MACRO_ASSERT_EQ_SZ(moved.length(), 0);
+    }
+    MACRO_ASSERT_EQ_SZ(new_calls, calls);
+    MACRO_ASSERT_EQ_SZ(c.allocs, c.frees);
+    MACRO_ASSERT_EQ_SZ(c.outstanding, 0);
+
+    aml::pool pool(1024);
+    aml::buffer pb(pool, 16);
+    pb.append("from the pool");
+    MACRO_ASSERT_STREQ(pb.data(), "from the pool");
+
+    aml::buffer heap;
+    heap.append("x");
+    aml::buffer other(8);
+    other = std::move(heap);
+    MACRO_ASSERT_STREQ(other.data(), "x");
+}
+
+/* --- runner --- */
+int main(void) {
+    macro_test_case tests[16];
+    size_t test_count = 0;
+
+    MACRO_ADD(tests, cpp_allocator_matches_c_calls);
+    MACRO_ADD(tests, cpp_allocator_containers);
+    MACRO_ADD(tests, cpp_pool_move_and_release);
+    MACRO_ADD(tests, cpp_pool_scope);
+    MACRO_ADD(tests, cpp_buffer);
+
+    macro_run_all("a-memory-library/aml_cpp", tests, test_count);
+    return 0;
+}
@@ -10,8 +10,11 @@
 #include "a-memory-library/aml_alloc.h"
 
 #include <string.h>
+#include <stdlib.h>
 #include <stdint.h>
 #include <stdarg.h>
+#include <pthread.h>
+#include <sys/wait.h>
 
 static char *pool_vdup(aml_pool_t *pool, const char *fmt, ...) {
     va_list args;
@@ -275,6 +278,1022 @@ MACRO_TEST(pool_strdupa_empty_array) {
     aml_pool_destroy(p);
 }
 
+#define CONCURRENT_THREADS 4
+#define CONCURRENT_ALLOCS 20000
+
+typedef struct {
+    aml_pool_t *pool;
+    unsigned char id;
+    unsigned char *ptrs[CONCURRENT_ALLOCS];
+} concurrent_arg_t;
+
+static void *concurrent_worker(void *p) {
+    concurrent_arg_t *arg = (concurrent_arg_t *)p;
+    for (size_t i = 0; i < CONCURRENT_ALLOCS; i++) {
+        size_t len = 8 + (i % 5) * 8;
+        unsigned char *m = (unsigned char *)aml_pool_concurrent_alloc(arg->pool, len);
+        memset(m, arg->id, len);
+        arg->ptrs[i] = m;
+    }
+    return NULL;
+}
+
+MACRO_TEST(pool_concurrent_alloc_no_overlap) {
+    // small blocks so that the threads race through many grows
+    aml_pool_t *p = aml_pool_init_concurrent(1024);
+    static concurrent_arg_t args[CONCURRENT_THREADS];
+    pthread_t threads[CONCURRENT_THREADS];
+    for (int t = 0; t < CONCURRENT_THREADS; t++) {
+        args[t].pool = p;
+        args[t].id = (unsigned char)(t + 1);
+        pthread_create(&threads[t], NULL, concurrent_worker, &args[t]);
+    }
+    for (int t = 0; t < CONCURRENT_THREADS; t++)
+        pthread_join(threads[t], NULL);
+
+    // every allocation must still hold the pattern of the thread that owns it
+    for (int t = 0; t < CONCURRENT_THREADS; t++) {
+        for (size_t i = 0; i < CONCURRENT_ALLOCS; i++) {
+            size_t len = 8 + (i % 5) * 8;
+            unsigned char *m = args[t].ptrs[i];
+            MACRO_ASSERT_TRUE(((uintptr_t)m & (sizeof(size_t) - 1)) == 0);
+            for (size_t j = 0; j < len; j++)
+                MACRO_ASSERT_EQ_INT(m[j], args[t].id);
+        }
+    }
+
+    char *s = aml_pool_concurrent_strdup(p, "shared");
+    MACRO_ASSERT_STREQ(s, "shared");
+    aml_pool_clear(p);
+    aml_pool_destroy(p);
+}
+
+static void *tls_worker(void *p) {
+    aml_pool_t **out = (aml_pool_t **)p;
+    aml_pool_t *pool = aml_pool_tls_get(256);
+    MACRO_ASSERT_TRUE(aml_pool_tls_get(4096) == pool);
+    char *s = aml_pool_strdup(pool, "per-thread");
+    MACRO_ASSERT_STREQ(s, "per-thread");
+    *out = pool;
+    // the pool is destroyed when this thread exits
+    return NULL;
+}
+
+MACRO_TEST(pool_tls_per_thread_lifecycle) {
+    aml_pool_t *mine = aml_pool_tls_get(256);
+    MACRO_ASSERT_TRUE(mine != NULL);
+    MACRO_ASSERT_TRUE(aml_pool_tls_get(256) == mine);
+
+    aml_pool_t *theirs = NULL;
+    pthread_t t;
+    pthread_create(&t, NULL, tls_worker, &theirs);
+    pthread_join(t, NULL);
+    MACRO_ASSERT_TRUE(theirs != NULL && theirs != mine);
+
+    size_t baseline = aml_pool_used(mine);
+    for (int i = 0; i < 100; i++) (void)aml_pool_alloc(mine, 64);
+    MACRO_ASSERT_TRUE(aml_pool_used(mine) > baseline);
+    aml_pool_tls_clear();
+    MACRO_ASSERT_TRUE(aml_pool_tls_get(256) == mine);
+    MACRO_ASSERT_EQ_SZ(aml_pool_used(mine), baseline);
+
+    aml_pool_tls_destroy();
+    aml_pool_tls_clear(); // no pool, nothing to do
+    aml_pool_t *again = aml_pool_tls_get(128);
+    MACRO_ASSERT_TRUE(again != NULL);
+    aml_pool_tls_destroy();
+}
+
+MACRO_TEST(pool_clear_retain_reuses_blocks) {
+    aml_pool_t *p = aml_pool_init(256);
+    size_t baseline = aml_pool_used(p);
+
+    char *first_cycle[40];
+    for (int i = 0; i < 40; i++) first_cycle[i] = (char*)aml_pool_alloc(p, 64);
+    size_t grown = aml_pool_used(p);
+    MACRO_ASSERT_TRUE(grown > baseline);
+
+    // the blocks stay with the pool and are handed out again in order
+    aml_pool_clear_retain(p);
+    MACRO_ASSERT_EQ_SZ(aml_pool_used(p), grown);
+    for (int i = 0; i < 40; i++) {
+        char *m = (char*)aml_pool_alloc(p, 64);
+        MACRO_ASSERT_TRUE(m == first_cycle[i]);
+    }
+    MACRO_ASSERT_EQ_SZ(aml_pool_used(p), grown);
+
+    // a regular clear returns to the initial footprint
+    aml_pool_clear_retain(p);
+    aml_pool_clear(p);
+    MACRO_ASSERT_EQ_SZ(aml_pool_used(p), baseline);
+
+    // with a limit, only the blocks that fit are kept
+    for (int i = 0; i < 40; i++) (void)aml_pool_alloc(p, 64);
+    aml_pool_set_retain_limit(p, 600);
+    aml_pool_clear_retain(p);
+    MACRO_ASSERT_TRUE(aml_pool_used(p) > baseline);
+    MACRO_ASSERT_TRUE(aml_pool_used(p) <= baseline + 600);
+
+    aml_pool_destroy(p);
+}
+
+MACRO_TEST(pool_adaptive_first_block) {
+    aml_pool_t *p = aml_pool_init(256);
+    aml_pool_set_adaptive(p, 4);
+    MACRO_ASSERT_EQ_SZ(aml_pool_adaptive_size(p), 0);
+
+    // each cycle needs 10000 bytes, far more than the initial block
+    for (int cycle = 0; cycle < 4; cycle++) {
+        for (int i = 0; i < 100; i++) (void)aml_pool_alloc(p, 100);
+        aml_pool_clear(p);
+    }
+    size_t learned = aml_pool_adaptive_size(p);
+    MACRO_ASSERT_TRUE(learned >= 10000);
+
+    // the next cycle runs in a single contiguous block
+    char *first = (char*)aml_pool_ualloc(p, 100);
+    char *last = first;
+    for (int i = 1; i < 100; i++) last = (char*)aml_pool_ualloc(p, 100);
+    MACRO_ASSERT_TRUE(last == first + 99 * 100);
+    memset(first, 1, 100 * 100);
+
+    // the learned size can seed a new pool that never grows
+    aml_pool_t *seeded = aml_pool_init(learned);
+    size_t before = aml_pool_used(seeded);
+    for (int i = 0; i < 100; i++) (void)aml_pool_alloc(seeded, 100);
+    MACRO_ASSERT_EQ_SZ(aml_pool_used(seeded), before);
+    aml_pool_destroy(seeded);
+
+    aml_pool_clear(p);
+    aml_pool_destroy(p);
+}
+
+MACRO_TEST(pool_hugepages_blocks) {
+    aml_pool_t *p = aml_pool_init_hugepages(1024 * 1024);
+    MACRO_ASSERT_TRUE(aml_pool_pages(p) != AML_POOL_PAGES_MALLOC);
+    // the first block is rounded up to a whole 2 MB page
+    MACRO_ASSERT_TRUE(aml_pool_used(p) >= 2 * 1024 * 1024);
+
+    aml_pool_marker_t m;
+    aml_pool_save(p, &m);
+    size_t before = aml_pool_used(p);
+
+    // grow well past the first block and touch all of the memory
+    for (int i = 0; i < 8; i++) {
+        char *b = (char*)aml_pool_alloc(p, 1024 * 1024);
+        memset(b, i, 1024 * 1024);
+    }
+    MACRO_ASSERT_TRUE(aml_pool_used(p) > before);
+
+    // restore unmaps the growth blocks
+    aml_pool_restore(p, &m);
+    MACRO_ASSERT_EQ_SZ(aml_pool_used(p), before);
+
+    char *s = aml_pool_strdup(p, "huge");
+    MACRO_ASSERT_STREQ(s, "huge");
+    aml_pool_clear(p);
+    aml_pool_destroy(p);
+
+    aml_pool_t *regular = aml_pool_init(1024);
+    MACRO_ASSERT_TRUE(aml_pool_pages(regular) == AML_POOL_PAGES_MALLOC);
+    aml_pool_destroy(regular);
+}
+
+typedef struct {
+    size_t calls;
+    size_t last_len;
+    size_t last_used;
+} growth_probe_t;
+
+static size_t growth_probe(void *arg, size_t used, size_t len) {
+    growth_probe_t *probe = (growth_probe_t*)arg;
+    probe->calls++;
+    probe->last_len = len;
+    probe->last_used = used;
+    return 8192;
+}
+
+MACRO_TEST(pool_growth_policies) {
+    // fixed: every growth block holds the same number of allocations
+    aml_pool_t *p = aml_pool_init(1024);
+    aml_pool_set_growth_fixed(p, 1024);
+    MACRO_ASSERT_EQ_SZ(aml_pool_blocks(p), 1);
+    for (int i = 0; i < 256; i++) (void)aml_pool_alloc(p, 64);
+    size_t fixed_blocks = aml_pool_blocks(p);
+    MACRO_ASSERT_TRUE(fixed_blocks >= 16);
+
+    // geometric: the pool doubles, so far fewer blocks are needed
+    aml_pool_clear(p);
+    aml_pool_set_growth_geometric(p, 1024 * 1024);
+    for (int i = 0; i < 256; i++) (void)aml_pool_alloc(p, 64);
+    size_t geometric_blocks = aml_pool_blocks(p);
+    MACRO_ASSERT_TRUE(geometric_blocks < fixed_blocks);
+    MACRO_ASSERT_TRUE(geometric_blocks <= 7);
+
+    // geometric respects the cap
+    aml_pool_clear(p);
+    aml_pool_set_growth_geometric(p, 2048);
+    for (int i = 0; i < 256; i++) (void)aml_pool_alloc(p, 64);
+    MACRO_ASSERT_TRUE(aml_pool_blocks(p) >= 8);
+
+    // callback: sees the footprint and the request, and a block always fits
+    // the request even if the callback asks for less
+    aml_pool_clear(p);
+    growth_probe_t probe = {0, 0, 0};
+    aml_pool_set_growth_callback(p, growth_probe, &probe);
+    size_t used = aml_pool_used(p);
+    char *big = (char*)aml_pool_alloc(p, 20000);
+    memset(big, 0, 20000);
+    MACRO_ASSERT_EQ_SZ(probe.calls, 1);
+    MACRO_ASSERT_EQ_SZ(probe.last_len, 20000);
+    MACRO_ASSERT_EQ_SZ(probe.last_used, used);
+    for (int i = 0; i < 100; i++) (void)aml_pool_alloc(p, 64);
+    MACRO_ASSERT_EQ_SZ(probe.calls, 2);
+
+    aml_pool_set_growth_callback(p, NULL, NULL);
+    aml_pool_destroy(p);
+}
+
+MACRO_TEST(pool_side_blocks_keep_current_tail) {
+    aml_pool_t *p = aml_pool_init(4096);
+    aml_pool_set_side_threshold(p, 2048);
+    size_t baseline = aml_pool_used(p);
+
+    char *a = (char*)aml_pool_alloc(p, 96);
+    char *big = (char*)aml_pool_alloc(p, 1024 * 1024);
+    memset(big, 7, 1024 * 1024);
+    char *b = (char*)aml_pool_alloc(p, 96);
+    // the small allocation keeps bumping in the first block
+    MACRO_ASSERT_TRUE(b == a + 96);
+    MACRO_ASSERT_EQ_SZ(aml_pool_blocks(p), 1);
+    MACRO_ASSERT_TRUE(aml_pool_used(p) > baseline + 1024 * 1024);
+
+    // restore releases side blocks added after the marker only
+    aml_pool_marker_t m;
+    aml_pool_save(p, &m);
+    size_t before = aml_pool_used(p);
+    char *big2 = (char*)aml_pool_alloc(p, 512 * 1024);
+    memset(big2, 1, 512 * 1024);
+    char *c = (char*)aml_pool_alloc(p, 96);
+    MACRO_ASSERT_TRUE(c == b + 96);
+    aml_pool_restore(p, &m);
+    MACRO_ASSERT_EQ_SZ(aml_pool_used(p), before);
+    MACRO_ASSERT_TRUE(big[1024 * 1024 - 1] == 7);
+
+    // below the threshold, growth works as before
+    for (int i = 0; i < 100; i++) (void)aml_pool_alloc(p, 1000);
+    MACRO_ASSERT_TRUE(aml_pool_blocks(p) > 1);
+
+    aml_pool_clear(p);
+    MACRO_ASSERT_EQ_SZ(aml_pool_used(p), baseline);
+    (void)aml_pool_alloc(p, 1024 * 1024);
+    aml_pool_clear_retain(p);
+    MACRO_ASSERT_EQ_SZ(aml_pool_used(p), baseline);
+    (void)aml_pool_alloc(p, 1024 * 1024);
+    aml_pool_destroy(p);
+}
+
+typedef struct {
+    size_t allocs;
+    size_t frees;
+    size_t outstanding;
+} counting_ctx_t;
+
+static void *counting_alloc(void *ctx, size_t len) {
+    counting_ctx_t *c = (counting_ctx_t*)ctx;
+    c->allocs++;
+    c->outstanding += len;
+    return malloc(len);
+}
+
+static void counting_free(void *ctx, void *p, size_t len) {
+    counting_ctx_t *c = (counting_ctx_t*)ctx;
+    c->frees++;
+    c->outstanding -= len;
+    free(p);
+}
+
+MACRO_TEST(pool_init_ex_uses_backing_allocator) {
+    counting_ctx_t c = {0, 0, 0};
+    aml_backing_allocator_t a = { counting_alloc, counting_free, NULL, &c };
+    aml_pool_t *p = aml_pool_init_ex(512, &a);
+    MACRO_ASSERT_EQ_SZ(c.allocs, 1);
+    MACRO_ASSERT_EQ_SZ(c.outstanding, aml_pool_used(p));
+
+    for (int i = 0; i < 100; i++) (void)aml_pool_alloc(p, 64);
+    MACRO_ASSERT_TRUE(c.allocs > 1);
+    MACRO_ASSERT_EQ_SZ(c.outstanding, aml_pool_used(p));
+
+    aml_pool_marker_t m;
+    aml_pool_save(p, &m);
+    aml_pool_set_side_threshold(p, 4096);
+    (void)aml_pool_alloc(p, 100000);
+    aml_pool_restore(p, &m);
+    MACRO_ASSERT_EQ_SZ(c.outstanding, aml_pool_used(p));
+
+    aml_pool_clear(p);
+    MACRO_ASSERT_EQ_SZ(c.outstanding, aml_pool_used(p));
+    aml_pool_destroy(p);
+    MACRO_ASSERT_EQ_SZ(c.allocs, c.frees);
+    MACRO_ASSERT_EQ_SZ(c.outstanding, 0);
+}
+
+MACRO_TEST(pool_numa_policies) {
+    aml_pool_numa_policy_t policies[] = {
+        AML_POOL_NUMA_LOCAL, AML_POOL_NUMA_BIND, AML_POOL_NUMA_INTERLEAVE
+    };
+    for (int i = 0; i < 3; i++) {
+        aml_pool_t *p = aml_pool_init_numa(64 * 1024, policies[i], 0);
+        if (policies[i] == AML_POOL_NUMA_INTERLEAVE)
+            MACRO_ASSERT_TRUE(aml_pool_numa_node(p) == -1);
+        else
+            MACRO_ASSERT_TRUE(aml_pool_numa_node(p) >= 0);
+        aml_pool_stats_t st;
+        aml_pool_get_stats(p, &st);
+        MACRO_ASSERT_EQ_INT(st.numa_node, aml_pool_numa_node(p));
+
+        for (int j = 0; j < 64; j++) {
+            char *m = (char*)aml_pool_alloc(p, 4096);
+            memset(m, j, 4096);
+        }
+        MACRO_ASSERT_TRUE(aml_pool_blocks(p) > 1);
+
+        // every resident page is reported on some node (or placement is
+        // unavailable and nothing is reported)
+        size_t pages[64];
+        size_t counted = aml_pool_numa_placement(p, pages, 64);
+        size_t sum = 0;
+        for (int n = 0; n < 64; n++) sum += pages[n];
+        MACRO_ASSERT_EQ_SZ(sum, counted);
+        MACRO_ASSERT_TRUE(counted == 0 || counted >= 64);
+
+        aml_pool_clear(p);
+        aml_pool_destroy(p);
+    }
+
+    aml_pool_t *regular = aml_pool_init(1024);
+    MACRO_ASSERT_TRUE(aml_pool_numa_node(regular) == -1);
+    aml_pool_destroy(regular);
+}
+
+MACRO_TEST(pool_realloc_last_in_place_and_copy) {
+    aml_pool_t *p = aml_pool_init(4096);
+
+    char *a = (char*)aml_pool_realloc_last(p, NULL, 0, 16);
+    memcpy(a, "0123456789abcdef", 16);
+    // the latest allocation grows and shrinks in place
+    char *b = (char*)aml_pool_realloc_last(p, a, 16, 1000);
+    MACRO_ASSERT_TRUE(a == b);
+    MACRO_ASSERT_TRUE(memcmp(b, "0123456789abcdef", 16) == 0);
+    b = (char*)aml_pool_realloc_last(p, b, 1000, 8);
+    MACRO_ASSERT_TRUE(a == b);
+    char *next = (char*)aml_pool_ualloc(p, 1);
+    MACRO_ASSERT_TRUE(next == a + 8);
+
+    // no longer the latest allocation, so the data is copied
+    char *c = (char*)aml_pool_realloc_last(p, b, 8, 64);
+    MACRO_ASSERT_TRUE(c != b);
+    MACRO_ASSERT_TRUE(((uintptr_t)c & (sizeof(size_t) - 1)) == 0);
+    MACRO_ASSERT_TRUE(memcmp(c, "01234567", 8) == 0);
+
+    // the latest allocation, but the block has no room
+    char *d = (char*)aml_pool_realloc_last(p, c, 64, 8192);
+    MACRO_ASSERT_TRUE(d != c);
+    MACRO_ASSERT_TRUE(memcmp(d, "01234567", 8) == 0);
+
+    aml_pool_destroy(p);
+}
+
+MACRO_TEST(pool_pop_and_stack_mode) {
+    aml_pool_t *p = aml_pool_init(1024);
+
+    // pop releases the top allocation
+    char *a = (char*)aml_pool_alloc(p, 100);
+    char *b = (char*)aml_pool_alloc(p, 100);
+    MACRO_ASSERT_TRUE(aml_pool_pop(p, b, 100));
+    MACRO_ASSERT_TRUE((char*)aml_pool_alloc(p, 100) == b);
+    // a stale pop of something below the top changes nothing
+    MACRO_ASSERT_TRUE(!aml_pool_pop(p, a, 100));
+    MACRO_ASSERT_TRUE(!aml_pool_pop(p, b, 50));
+    MACRO_ASSERT_TRUE(aml_pool_pop(p, b, 100));
+    // the padding in front of b wasn't given back, so a only pops with it
+    MACRO_ASSERT_TRUE(!aml_pool_pop(p, a, 100));
+    MACRO_ASSERT_TRUE(aml_pool_pop(p, a, b - a));
+    MACRO_ASSERT_TRUE((char*)aml_pool_alloc(p, 100) == a);
+
+    // a short allocation after p keeps p from being popped
+    char *s1 = aml_pool_strdup(p, "a");
+    char *s2 = aml_pool_strdup(p, "b");
+    MACRO_ASSERT_TRUE(!aml_pool_pop(p, s1, 2));
+    MACRO_ASSERT_STREQ(aml_pool_strdup(p, "c"), "c");
+    MACRO_ASSERT_STREQ(s2, "b");
+    aml_pool_destroy(p);
+
+    // stepping back into a block needs p to have been its last allocation,
+    // and gives back exactly the tail that growing added to the size
+    p = aml_pool_init(1024);
+    (void)aml_pool_alloc(p, 1000);
+    (void)aml_pool_alloc(p, 600);
+    char *g = (char*)aml_pool_alloc(p, 300);
+    char *t = aml_pool_strdup(p, "x");
+    char *frame = (char*)aml_pool_alloc(p, 500);
+    MACRO_ASSERT_EQ_SZ(aml_pool_blocks(p), 3);
+    MACRO_ASSERT_TRUE(aml_pool_pop(p, frame, 500));
+    MACRO_ASSERT_TRUE(!aml_pool_pop(p, g, 300));
+    MACRO_ASSERT_EQ_SZ(aml_pool_blocks(p), 3);
+    MACRO_ASSERT_STREQ(t, "x");
+    aml_pool_destroy(p);
+
+    p = aml_pool_init(1024);
+    (void)aml_pool_alloc(p, 1000);
+    (void)aml_pool_alloc(p, 600);
+    (void)aml_pool_alloc(p, 500);
+    g = (char*)aml_pool_alloc(p, 300);
+    size_t size = aml_pool_size(p);
+    frame = (char*)aml_pool_alloc(p, 500);
+    MACRO_ASSERT_EQ_SZ(aml_pool_blocks(p), 4);
+    MACRO_ASSERT_TRUE(aml_pool_pop(p, frame, 500));
+    MACRO_ASSERT_TRUE(aml_pool_pop(p, g, 300));
+    MACRO_ASSERT_EQ_SZ(aml_pool_blocks(p), 3);
+    MACRO_ASSERT_EQ_SZ(aml_pool_size(p), size + 300);
+    aml_pool_destroy(p);
+
+    // stack mode: recursion oscillating around a block boundary reuses
+    // the growth block instead of allocating a new one each time
+    counting_ctx_t c = {0, 0, 0};
+    aml_backing_allocator_t alloc = { counting_alloc, counting_free, NULL, &c };
+    p = aml_pool_init_ex(1024, &alloc);
+    aml_pool_set_stack_mode(p, true);
+    char *base = (char*)aml_pool_alloc(p, 800);
+    char *top = (char*)aml_pool_alloc(p, 100);
+    for (int i = 0; i < 1000; i++) {
+        char *frame = (char*)aml_pool_alloc(p, 200);  // crosses into a new block
+        memset(frame, i, 200);
+        MACRO_ASSERT_TRUE(aml_pool_pop(p, frame, 200));
+        MACRO_ASSERT_EQ_SZ(aml_pool_blocks(p), 2);
+        char *deeper = (char*)aml_pool_alloc(p, 16);
+        MACRO_ASSERT_TRUE(aml_pool_pop(p, deeper, 16));
+        // only the last allocation in base's block can step back into it
+        MACRO_ASSERT_TRUE(!aml_pool_pop(p, base, 800));
+        MACRO_ASSERT_TRUE(!aml_pool_pop(p, top, 50));
+        // the growth block is empty, so the pool steps back to top's block
+        MACRO_ASSERT_TRUE(aml_pool_pop(p, top, 100));
+        MACRO_ASSERT_EQ_SZ(aml_pool_blocks(p), 1);
+        MACRO_ASSERT_TRUE((char*)aml_pool_alloc(p, 100) == top);
+    }
+    MACRO_ASSERT_EQ_SZ(c.allocs, 2);
+
+    // restore keeps blocks in stack mode
+    aml_pool_marker_t m;
+    aml_pool_save(p, &m);
+    for (int i = 0; i < 10; i++) (void)aml_pool_alloc(p, 1000);
+    size_t grown = c.allocs;
+    aml_pool_restore(p, &m);
+    for (int i = 0; i < 10; i++) (void)aml_pool_alloc(p, 1000);
+    aml_pool_restore(p, &m);
+    MACRO_ASSERT_EQ_SZ(c.allocs, grown);
+    MACRO_ASSERT_EQ_SZ(c.frees, 0);
+
+    // something that isn't the top can't be popped
+    char *x = (char*)aml_pool_alloc(p, 8);
+    MACRO_ASSERT_TRUE(!aml_pool_pop(p, x + 1024 * 1024, 8));
+    MACRO_ASSERT_TRUE(aml_pool_pop(p, x, 8));
+
+    aml_pool_destroy(p);
+    MACRO_ASSERT_EQ_SZ(c.outstanding, 0);
+}
+
+typedef struct compact_node_s {
+    struct compact_node_s *next;
+    char *name;
+    int64_t offset;  // self-relative, to the node before this one
+    int value;
+} compact_node_t;
+
+typedef struct {
+    compact_node_t *head;
+    char *big;
+    size_t calls;
+} compact_roots_t;
+
+static void compact_fixup(void *arg, const aml_pool_relocation_t *r) {
+    compact_roots_t *roots = (compact_roots_t*)arg;
+    roots->calls++;
+    roots->head = (compact_node_t*)aml_pool_relocate(r, roots->head);
+    roots->big = (char*)aml_pool_relocate(r, roots->big);
+    for (compact_node_t *n = roots->head; n; n = n->next) {
+        n->next = (compact_node_t*)aml_pool_relocate(r, n->next);
+        n->name = (char*)aml_pool_relocate(r, n->name);
+        aml_pool_relocate_offset(r, &n->offset);
+    }
+}
+
+MACRO_TEST(pool_compact_relocates) {
+    aml_pool_t *p = aml_pool_init(1024);
+    aml_pool_set_side_threshold(p, 4096);
+    compact_roots_t roots = { NULL, NULL, 0 };
+    char name[32];
+    for (int i = 0; i < 500; i++) {
+        compact_node_t *n = (compact_node_t*)aml_pool_zalloc(p, sizeof(*n));
+        snprintf(name, sizeof(name), "node-%d", i);
+        n->name = aml_pool_strdup(p, name);
+        n->value = i;
+        // filler that leaves uneven tails at the ends of blocks
+        memset(aml_pool_alloc(p, 150 + i % 50), 0, 150 + i % 50);
+        if (roots.head)
+            n->offset = (char*)roots.head - (char*)&n->offset;
+        n->next = roots.head;
+        roots.head = n;
+    }
+    // a side block
+    roots.big = (char*)aml_pool_alloc(p, 10000);
+    memset(roots.big, 'x', 10000);
+    MACRO_ASSERT_TRUE(aml_pool_blocks(p) > 10);
+    size_t used_before = aml_pool_used(p);
+
+    size_t len = 0;
+    char *image = (char*)aml_pool_compact(p, &len, compact_fixup, &roots);
+    MACRO_ASSERT_EQ_SZ(roots.calls, 1);
+    MACRO_ASSERT_EQ_SZ(aml_pool_blocks(p), 1);
+    MACRO_ASSERT_TRUE(aml_pool_used(p) < used_before);
+    MACRO_ASSERT_TRUE(len > 500 * (sizeof(compact_node_t) + 150) + 10000);
+
+    // everything moved into the image and the links were fixed
+    MACRO_ASSERT_TRUE((char*)roots.head >= image && (char*)roots.head < image + len);
+    int expected = 499;
+    for (compact_node_t *n = roots.head; n; n = n->next) {
+        MACRO_ASSERT_EQ_INT(n->value, expected);
+        snprintf(name, sizeof(name), "node-%d", expected);
+        MACRO_ASSERT_STREQ(n->name, name);
+        MACRO_ASSERT_TRUE(n->name >= image && n->name < image + len);
+        if (n->next)
+            MACRO_ASSERT_TRUE((char*)&n->offset + n->offset == (char*)n->next);
+        expected--;
+    }
+    MACRO_ASSERT_EQ_INT(expected, -1);
+
+    // the side block came along
+    MACRO_ASSERT_TRUE(roots.big >= image && roots.big + 10000 <= image + len);
+    size_t xs = 0;
+    while (xs < 10000 && roots.big[xs] == 'x') xs++;
+    MACRO_ASSERT_EQ_SZ(xs, 10000);
+
+    // the image is right sized, so the next allocation may grow the pool, and
+    // clearing goes back to the image's block
+    MACRO_ASSERT_STREQ(aml_pool_strdup(p, "after"), "after");
+    aml_pool_clear(p);
+    MACRO_ASSERT_EQ_SZ(aml_pool_blocks(p), 1);
+    MACRO_ASSERT_TRUE(aml_pool_size(p) >= len);
+    aml_pool_destroy(p);
+}
+
+static void compact_count(void *arg, const aml_pool_relocation_t *r) {
+    (void)r;
+    (*(size_t*)arg)++;
+}
+
+static void compact_slots(void *arg, const aml_pool_relocation_t *r) {
+    void **slots = (void**)arg;
+    for (int i = 0; i < 40; i++)
+        slots[i] = aml_pool_relocate(r, slots[i]);
+    MACRO_ASSERT_TRUE(aml_pool_relocate(r, NULL) == NULL);
+    MACRO_ASSERT_TRUE(aml_pool_relocate(r, slots) == slots);
+}
+
+MACRO_TEST(pool_compact_in_place) {
+    aml_pool_t *p = aml_pool_init(1 << 20);
+    char *head = aml_pool_strdup(p, "head");
+    // a growth block which then shrinks, like a vector after shrink_to_fit
+    char *a = (char*)aml_pool_alloc(p, 1 << 20);
+    a = (char*)aml_pool_realloc_last(p, a, 1 << 20, 64 * 1024);
+    memset(a, 'a', 64 * 1024);
+    MACRO_ASSERT_EQ_SZ(aml_pool_blocks(p), 2);
+    size_t used_before = aml_pool_used(p);
+
+    // the live bytes fit in the initial block, so nothing new is allocated
+    // and what was already there stays put
+    size_t len = 0;
+    char *image = (char*)aml_pool_compact(p, &len, NULL, NULL);
+    MACRO_ASSERT_TRUE(image == head);
+    MACRO_ASSERT_STREQ(head, "head");
+    MACRO_ASSERT_TRUE(len >= 64 * 1024 + 5);
+    MACRO_ASSERT_EQ_SZ(aml_pool_blocks(p), 1);
+    MACRO_ASSERT_TRUE(aml_pool_used(p) < used_before);
+    MACRO_ASSERT_TRUE(p->current == (aml_pool_node_t*)(p + 1));
+    MACRO_ASSERT_TRUE(image[len - 1] == 'a');
+    size_t used_after = aml_pool_used(p);
+
+    // a pool which outgrew its initial block keeps it, but doesn't hold on to
+    // it twice once a later compaction fits there again
+    for (int i = 0; i < 40; i++)
+        aml_pool_alloc(p, 64 * 1024);
+    aml_pool_compact(p, &len, NULL, NULL);
+    aml_pool_clear(p);
+    aml_pool_alloc(p, 100);
+    aml_pool_compact(p, &len, NULL, NULL);
+    MACRO_ASSERT_TRUE(len >= 100 && len < 100 + 64);
+    MACRO_ASSERT_TRUE(aml_pool_used(p) <= used_after);
+    aml_pool_destroy(p);
+}
+
+MACRO_TEST(pool_compact_single_block_and_alignment) {
+    aml_pool_t *p = aml_pool_init(4096);
+    char *s = aml_pool_strdup(p, "hello");
+    size_t calls = 0, len = 0;
+    char *image = (char*)aml_pool_compact(p, &len, compact_count, &calls);
+    MACRO_ASSERT_EQ_SZ(calls, 0);
+    MACRO_ASSERT_TRUE(image == s);
+    MACRO_ASSERT_EQ_SZ(len, 6);
+    aml_pool_destroy(p);
+
+    // 64 byte alignment survives the move, NULL and pointers outside of the
+    // pool pass through aml_pool_relocate
+    p = aml_pool_init(256);
+    void *slots[40];
+    for (int i = 0; i < 40; i++) {
+        slots[i] = aml_pool_aalloc(p, 64, 40);
+        memset(slots[i], i, 40);
+    }
+    aml_pool_compact(p, NULL, compact_slots, slots);
+    MACRO_ASSERT_EQ_SZ(aml_pool_blocks(p), 1);
+    for (int i = 0; i < 40; i++) {
+        MACRO_ASSERT_EQ_SZ((uintptr_t)slots[i] & 63, 0);
+        MACRO_ASSERT_EQ_INT(((unsigned char*)slots[i])[39], i);
+    }
+    aml_pool_destroy(p);
+}
+
+MACRO_TEST(pool_get_stats) {
+    aml_pool_t *p = aml_pool_init(1024);
+    aml_pool_stats_t st;
+    aml_pool_get_stats(p, &st);
+    MACRO_ASSERT_EQ_SZ(st.blocks, 1);
+    MACRO_ASSERT_EQ_SZ(st.side_blocks, 0);
+    MACRO_ASSERT_EQ_SZ(st.used, aml_pool_used(p));
+    MACRO_ASSERT_EQ_INT(st.numa_node, -1);
+
+    (void)aml_pool_ualloc(p, 3);
+    (void)aml_pool_alloc(p, 8);     // 5 bytes of padding
+    (void)aml_pool_alloc(p, 1010);  // leaves 1024 - 16 bytes behind
+    aml_pool_marker_t m;
+    aml_pool_save(p, &m);
+    (void)aml_pool_strdup(p, "x");
+    aml_pool_restore(p, &m);
+
+    aml_pool_get_stats(p, &st);
+    MACRO_ASSERT_EQ_SZ(st.blocks, 2);
+    MACRO_ASSERT_EQ_SZ(st.used, aml_pool_used(p));
+#ifdef _AML_POOL_STATS_
+    MACRO_ASSERT_TRUE(st.counting);
+    MACRO_ASSERT_EQ_SZ(st.allocs, 4);
+    MACRO_ASSERT_EQ_SZ(st.grows, 1);
+    MACRO_ASSERT_EQ_SZ(st.align_bytes, 5);
+    MACRO_ASSERT_EQ_SZ(st.wasted_bytes, 1024 - 16);
+    MACRO_ASSERT_EQ_SZ(st.restores, 1);
+    MACRO_ASSERT_EQ_SZ(st.clears, 0);
+#else
+    MACRO_ASSERT_TRUE(!st.counting);
+    MACRO_ASSERT_EQ_SZ(st.allocs, 0);
+#endif
+
+    aml_pool_clear(p);
+    aml_pool_get_stats(p, &st);
+    MACRO_ASSERT_EQ_SZ(st.blocks, 1);
+    MACRO_ASSERT_TRUE(st.max_used > st.used);
+#ifdef _AML_POOL_STATS_
+    MACRO_ASSERT_EQ_SZ(st.clears, 1);
+    MACRO_ASSERT_EQ_SZ(st.allocs, 4);
+#endif
+    aml_pool_destroy(p);
+}
+
+MACRO_TEST(pool_alloc_batch_and_array) {
+    aml_pool_t *p = aml_pool_init(1024);
+    void *ptrs[100];
+
+    // all of them fit in the first block, back to back and aligned
+    aml_pool_ualloc(p, 3);
+    aml_pool_alloc_batch(p, 10, 20, ptrs);
+    for (int i = 0; i < 10; i++) {
+        MACRO_ASSERT_EQ_SZ((size_t)ptrs[i] & (sizeof(size_t) - 1), 0);
+        if (i)
+            MACRO_ASSERT_EQ_SZ((char*)ptrs[i] - (char*)ptrs[i-1], 24);
+        memset(ptrs[i], i, 20);
+    }
+    MACRO_ASSERT_EQ_SZ(aml_pool_blocks(p), 1);
+    MACRO_ASSERT_TRUE((char*)aml_pool_alloc(p, 8) == (char*)ptrs[9] + 24);
+
+    // the batch is split once, the rest share one new block
+    aml_pool_alloc_batch(p, 100, 24, ptrs);
+    MACRO_ASSERT_EQ_SZ(aml_pool_blocks(p), 2);
+    size_t jumps = 0;
+    for (int i = 0; i < 100; i++) {
+        memset(ptrs[i], 0xab, 24);
+        if (i && (char*)ptrs[i] - (char*)ptrs[i-1] != 24)
+            jumps++;
+    }
+    MACRO_ASSERT_EQ_SZ(jumps, 1);
+    for (int i = 0; i < 100; i++)
+        MACRO_ASSERT_EQ_INT(((unsigned char*)ptrs[i])[23], 0xab);
+
+    // nothing fits, one block holds them all
+    aml_pool_alloc(p, 1024 - 16);
+    aml_pool_alloc_batch(p, 50, 24, ptrs);
+    for (int i = 1; i < 50; i++)
+        MACRO_ASSERT_EQ_SZ((char*)ptrs[i] - (char*)ptrs[i-1], 24);
+
+    aml_pool_alloc_batch(p, 0, 24, NULL);
+
+    int *a = (int*)aml_pool_alloc_array(p, 100, sizeof(int));
+    for (int i = 0; i < 100; i++)
+        a[i] = i;
+    MACRO_ASSERT_EQ_INT(a[99], 99);
+    MACRO_ASSERT_EQ_SZ((size_t)a & (sizeof(size_t) - 1), 0);
+    aml_pool_destroy(p);
+}
+
+AML_POOL_DEFINE(simd_pool, 64, 4096)
+AML_POOL_DEFINE(byte_pool, 1, 256)
+
+MACRO_TEST(pool_define_specialized) {
+    simd_pool_t *p = simd_pool_init();
+    char *prev = NULL;
+    for (size_t i = 1; i < 200; i++) {
+        char *a = (char*)simd_pool_alloc(p, i);
+        MACRO_ASSERT_EQ_SZ((size_t)a & 63, 0);
+        MACRO_ASSERT_TRUE(a != prev);
+        memset(a, 0x5a, i);
+        prev = a;
+        // the generic functions work on the same pool in between
+        aml_pool_strdup(p, "x");
+    }
+    // 200 64 byte slots don't fit in one 4096 byte block
+    MACRO_ASSERT_TRUE(aml_pool_blocks(p) > 1);
+
+    // bigger than a block, straight to a block of its own
+    char *big = (char*)simd_pool_alloc(p, 8192);
+    MACRO_ASSERT_EQ_SZ((size_t)big & 63, 0);
+    memset(big, 1, 8192);
+
+    unsigned char *z = (unsigned char*)simd_pool_zalloc(p, 100);
+    MACRO_ASSERT_EQ_SZ((size_t)z & 63, 0);
+    for (int i = 0; i < 100; i++)
+        MACRO_ASSERT_EQ_INT(z[i], 0);
+    aml_pool_clear(p);
+    aml_pool_destroy(p);
+
+    // an alignment of 1 packs allocations back to back
+    byte_pool_t *b = byte_pool_init();
+    char *c1 = (char*)byte_pool_alloc(b, 3);
+    char *c2 = (char*)byte_pool_alloc(b, 5);
+    MACRO_ASSERT_TRUE(c2 == c1 + 3);
+    aml_pool_destroy(b);
+}
+
+MACRO_TEST(pool_init_external) {
+    _Alignas(16) char mem[4096];
+    // an odd address still gets an aligned header
+    aml_pool_t *p = aml_pool_init_external(mem + 3, sizeof(mem) - 3,
+                                           AML_POOL_EXTERNAL_GROW);
+    MACRO_ASSERT_TRUE(p != NULL);
+    MACRO_ASSERT_TRUE((char*)p >= mem + 3 && (char*)p < mem + 64);
+    MACRO_ASSERT_EQ_SZ((size_t)p & (sizeof(size_t) - 1), 0);
+
+    char *a = (char*)aml_pool_alloc(p, 1000);
+    MACRO_ASSERT_TRUE(a > mem && a + 1000 <= mem + sizeof(mem));
+    memset(a, 1, 1000);
+    MACRO_ASSERT_EQ_SZ(aml_pool_blocks(p), 1);
+
+    // past the end of mem, growth comes from the heap
+    char *b = (char*)aml_pool_alloc(p, 3500);
+    MACRO_ASSERT_TRUE(b + 3500 <= mem || b >= mem + sizeof(mem));
+    memset(b, 2, 3500);
+    MACRO_ASSERT_EQ_SZ(aml_pool_blocks(p), 2);
+
+    aml_pool_clear(p);
+    MACRO_ASSERT_EQ_SZ(aml_pool_blocks(p), 1);
+    a = (char*)aml_pool_alloc(p, 16);
+    MACRO_ASSERT_TRUE(a > mem && a < mem + sizeof(mem));
+    aml_pool_destroy(p);
+
+    // a fixed pool works the same way while it fits
+    static char region[1024];
+    p = aml_pool_init_external(region, sizeof(region), AML_POOL_EXTERNAL_FIXED);
+    MACRO_ASSERT_TRUE(p != NULL);
+    for (int i = 0; i < 10; i++) {
+        char *s = aml_pool_strdupf(p, "item-%d", i);
+        MACRO_ASSERT_TRUE(s > region && s < region + sizeof(region));
+    }
+    aml_pool_marker_t m;
+    aml_pool_save(p, &m);
+    aml_pool_alloc(p, 100);
+    aml_pool_restore(p, &m);
+    MACRO_ASSERT_EQ_SZ(aml_pool_blocks(p), 1);
+    aml_pool_destroy(p);
+
+    MACRO_ASSERT_TRUE(aml_pool_init_external(region, 16, 0) == NULL);
+    MACRO_ASSERT_TRUE(aml_pool_init_external(NULL, 4096, 0) == NULL);
+}
+
+/* runs fn in a child and returns true if it died */
+static bool guard_faults(void (*fn)(char *, size_t), char *p, size_t len) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        fn(p, len);
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+}
+
+static void write_past(char *p, size_t len) {
+    ((volatile char *)p)[len] = 1;
+}
+
+static void write_last(char *p, size_t len) {
+    ((volatile char *)p)[len - 1] = 1;
+}
+
+MACRO_TEST(pool_init_guarded) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    aml_pool_t *p = aml_pool_init_guarded(4096, AML_POOL_GUARD_BLOCKS);
+    MACRO_ASSERT_TRUE(aml_pool_pages(p) == AML_POOL_PAGES_MMAP);
+    // fill the first block, then run off its end
+    char *a = (char*)aml_pool_alloc(p, 1000);
+    char *end = p->current->endp;
+    MACRO_ASSERT_EQ_SZ((size_t)end & (page - 1), 0);
+    memset(a, 1, 1000);
+    MACRO_ASSERT_TRUE(!guard_faults(write_last, end - 1, 1));
+    MACRO_ASSERT_TRUE(guard_faults(write_past, end - 1, 1));
+    // growth blocks are guarded too
+    aml_pool_alloc(p, 10000);
+    MACRO_ASSERT_EQ_SZ(aml_pool_blocks(p), 2);
+    MACRO_ASSERT_TRUE(guard_faults(write_past, p->current->endp - 1, 1));
+    aml_pool_clear(p);
+    MACRO_ASSERT_EQ_SZ(aml_pool_blocks(p), 1);
+    aml_pool_destroy(p);
+
+    p = aml_pool_init_guarded(4096, AML_POOL_GUARD_ALLOCS);
+    char *prev = NULL;
+    for (size_t len = 8; len <= 64; len += 8) {
+        char *b = (char*)aml_pool_alloc(p, len);
+        // every allocation ends at its own guard page
+        MACRO_ASSERT_EQ_SZ((size_t)(b + len) & (page - 1), 0);
+        MACRO_ASSERT_TRUE(b != prev);
+        memset(b, 2, len);
+        prev = b;
+    }
+    MACRO_ASSERT_TRUE(guard_faults(write_past, prev, 64));
+    // lengths that aren't a multiple of sizeof(size_t) end at the page too,
+    // so a one byte overrun is caught
+    char *odd = (char*)aml_pool_alloc(p, 13);
+    MACRO_ASSERT_EQ_SZ((size_t)(odd + 13) & (page - 1), 0);
+    MACRO_ASSERT_TRUE(!guard_faults(write_last, odd, 13));
+    MACRO_ASSERT_TRUE(guard_faults(write_past, odd, 13));
+    int *ints = (int*)aml_pool_alloc(p, 3 * sizeof(int));
+    MACRO_ASSERT_EQ_SZ((size_t)ints & (sizeof(int) - 1), 0);
+    MACRO_ASSERT_TRUE(guard_faults(write_past, (char*)ints, 3 * sizeof(int)));
+    // unaligned allocations end exactly at the guard page
+    char *s = aml_pool_strdup(p, "guarded");
+    MACRO_ASSERT_STREQ(s, "guarded");
+    MACRO_ASSERT_EQ_SZ((size_t)(s + 8) & (page - 1), 0);
+    s = aml_pool_strdup(p, "abc");
+    MACRO_ASSERT_TRUE(guard_faults(write_past, s, 4));
+    char *f = aml_pool_strdupf(p, "%s-%d", "fmt", 7);
+    MACRO_ASSERT_STREQ(f, "fmt-7");
+    MACRO_ASSERT_TRUE(guard_faults(write_past, f, 6));
+    // popping, shrinking and splitting never leave room to bump into
+    char *t = (char*)aml_pool_alloc(p, 64);
+    MACRO_ASSERT_TRUE(!aml_pool_pop(p, t, 64));
+    t = (char*)aml_pool_realloc_last(p, t, 64, 32);
+    MACRO_ASSERT_EQ_SZ((size_t)(t + 32) & (page - 1), 0);
+    MACRO_ASSERT_TRUE(p->curp == p->current->endp);
+    size_t n = 0;
+    char **fields = aml_pool_split(p, &n, ',', "a,b,c");
+    MACRO_ASSERT_EQ_SZ(n, 3);
+    MACRO_ASSERT_STREQ(fields[2], "c");
+    char *a8 = (char*)aml_pool_alloc(p, 8);
+    char *b8 = (char*)aml_pool_alloc(p, 8);
+    MACRO_ASSERT_TRUE(b8 != a8 + 8 && a8 != b8 + 8);
+    MACRO_ASSERT_TRUE(guard_faults(write_past, a8, 8));
+    void *ptrs[3];
+    aml_pool_alloc_batch(p, 3, 16, ptrs);
+    for (int i = 0; i < 3; i++)
+        MACRO_ASSERT_EQ_SZ((size_t)((char*)ptrs[i] + 16) & (page - 1), 0);
+    char *v = (char*)aml_pool_aalloc(p, 64, 100);
+    MACRO_ASSERT_EQ_SZ((size_t)v & 63, 0);
+    memset(v, 3, 100);
+    aml_pool_clear(p);
+    MACRO_ASSERT_EQ_SZ(aml_pool_blocks(p), 1);
+    MACRO_ASSERT_EQ_SZ((size_t)((char*)aml_pool_alloc(p, 24) + 24) & (page - 1), 0);
+    aml_pool_destroy(p);
+}
+
+MACRO_TEST(pool_intern_and_split) {
+    aml_pool_t *p = aml_pool_init(1024);
+    char buf[16];
+    strcpy(buf, "token");
+    const char *a = aml_pool_intern(p, buf, 5);
+    strcpy(buf, "other");
+    MACRO_ASSERT_STREQ(a, "token");
+    MACRO_ASSERT_TRUE(aml_pool_intern(p, "token", 5) == a);
+    MACRO_ASSERT_TRUE(aml_pool_intern(p, "tokens", 5) == a);
+    MACRO_ASSERT_TRUE(aml_pool_intern(p, "tok", 3) != a);
+    MACRO_ASSERT_STREQ(aml_pool_intern(p, "", 0), "");
+    MACRO_ASSERT_EQ_SZ(aml_pool_interned(p), 3);
+
+    // interned strings survive a restore of the pool
+    aml_pool_marker_t m;
+    aml_pool_save(p, &m);
+    const char *b = aml_pool_intern(p, "after save", 10);
+    for (int i = 0; i < 100; i++)
+        aml_pool_alloc(p, 100);
+    aml_pool_restore(p, &m);
+    MACRO_ASSERT_STREQ(b, "after save");
+    MACRO_ASSERT_TRUE(aml_pool_intern(p, "after save", 10) == b);
+
+    // only the arrays come from the pool
+    size_t n;
+    const char **t1 = aml_pool_split_intern(p, &n, ',', "GET,/index,200,GET");
+    MACRO_ASSERT_EQ_SZ(n, 4);
+    MACRO_ASSERT_TRUE(t1[0] == t1[3]);
+    MACRO_ASSERT_STREQ(t1[1], "/index");
+    MACRO_ASSERT_TRUE(t1[4] == NULL);
+    const char **t2 = aml_pool_split_intern(p, &n, ',', ",GET,");
+    MACRO_ASSERT_EQ_SZ(n, 3);
+    MACRO_ASSERT_TRUE(t2[1] == t1[0]);
+    MACRO_ASSERT_TRUE(t2[0] == t2[2]);
+    MACRO_ASSERT_STREQ(t2[0], "");
+
+    char *before = (char *)aml_pool_alloc(p, 1);
+    const char **c = aml_pool_split_csv_intern(p, &n, "GET,\"a,b\",\"x\"\"y\"");
+    MACRO_ASSERT_EQ_SZ(n, 3);
+    MACRO_ASSERT_TRUE(c[0] == t1[0]);
+    MACRO_ASSERT_STREQ(c[1], "a,b");
+    MACRO_ASSERT_STREQ(c[2], "x\"y");
+    MACRO_ASSERT_TRUE(c[3] == NULL);
+    // the unescaped copy was given back, the top is the end of the array
+    MACRO_ASSERT_TRUE(p->curp == (char *)(c + 4));
+    MACRO_ASSERT_TRUE((char *)c > before);
+    // and the fields and the array survive what is allocated in its place
+    char *after = (char *)aml_pool_ualloc(p, 40);
+    MACRO_ASSERT_TRUE(after == (char *)(c + 4));
+    memset(after, '#', 40);
+    MACRO_ASSERT_TRUE(c[0] == t1[0]);
+    MACRO_ASSERT_STREQ(c[1], "a,b");
+    MACRO_ASSERT_STREQ(c[2], "x\"y");
+    MACRO_ASSERT_TRUE(c[3] == NULL);
+    const char **t = aml_pool_split_tsv_intern(p, &n, "a,b\tGET");
+    MACRO_ASSERT_TRUE(t[0] == c[1]);
+    MACRO_ASSERT_TRUE(t[1] == t1[0]);
+
+    MACRO_ASSERT_TRUE(aml_pool_split_intern(p, &n, ',', NULL)[0] == NULL);
+    MACRO_ASSERT_EQ_SZ(n, 0);
+
+    aml_pool_clear(p);
+    MACRO_ASSERT_EQ_SZ(aml_pool_interned(p), 0);
+    MACRO_ASSERT_STREQ(aml_pool_intern(p, "token", 5), "token");
+    MACRO_ASSERT_EQ_SZ(aml_pool_interned(p), 1);
+    aml_pool_destroy(p);
+}
+
+static void intern_fixed(char *mem, size_t len) {
+    aml_pool_t *p = aml_pool_init_external(mem, len, AML_POOL_EXTERNAL_FIXED);
+    aml_pool_intern(p, "x", 1);
+}
+
+MACRO_TEST(pool_intern_follows_allocator) {
+    // the side pool comes from the same backing allocator
+    counting_ctx_t c = {0, 0, 0};
+    aml_backing_allocator_t a = { counting_alloc, counting_free, NULL, &c };
+    aml_pool_t *p = aml_pool_init_ex(512, &a);
+    size_t allocs = c.allocs;
+    MACRO_ASSERT_STREQ(aml_pool_intern(p, "backed", 6), "backed");
+    MACRO_ASSERT_TRUE(c.allocs > allocs);
+    MACRO_ASSERT_TRUE(p->intern_pool->backing == &a);
+    aml_pool_destroy(p);
+    MACRO_ASSERT_EQ_SZ(c.outstanding, 0);
+
+    // and from the parent of a sub-pool, so it goes away with the parent
+    aml_pool_t *parent = aml_pool_init(64 * 1024);
+    aml_pool_t *sub = aml_pool_pool_init(parent, 512);
+    const char *s = aml_pool_intern(sub, "nested", 6);
+    MACRO_ASSERT_TRUE(sub->intern_pool->pool == parent);
+    MACRO_ASSERT_TRUE(aml_pool_intern(sub, "nested", 6) == s);
+    aml_pool_destroy(parent);
+
+    p = aml_pool_init_numa(64 * 1024, AML_POOL_NUMA_BIND, 0);
+    aml_pool_intern(p, "numa", 4);
+    MACRO_ASSERT_EQ_INT(aml_pool_numa_node(p->intern_pool), 0);
+    aml_pool_destroy(p);
+
+    // a fixed pool can't grow, so interning aborts instead of using malloc
+    char region[4096];
+    MACRO_ASSERT_TRUE(guard_faults(intern_fixed, region, sizeof(region)));
+}
+
 /* --- runner --- */
 int main(void) {
     macro_test_case tests[128];
@@ -292,6 +1311,27 @@ int main(void) {
     MACRO_ADD(tests, pool_base64_roundtrip);
     MACRO_ADD(tests, pool_subpool_lifecycle);
     MACRO_ADD(tests, pool_strdupa_empty_array);
+    MACRO_ADD(tests, pool_concurrent_alloc_no_overlap);
+    MACRO_ADD(tests, pool_tls_per_thread_lifecycle);
+    MACRO_ADD(tests, pool_clear_retain_reuses_blocks);
+    MACRO_ADD(tests, pool_adaptive_first_block);
+    MACRO_ADD(tests, pool_hugepages_blocks);
+    MACRO_ADD(tests, pool_growth_policies);
+    MACRO_ADD(tests, pool_side_blocks_keep_current_tail);
+    MACRO_ADD(tests, pool_init_ex_uses_backing_allocator);
+    MACRO_ADD(tests, pool_numa_policies);
+    MACRO_ADD(tests, pool_realloc_last_in_place_and_copy);
+    MACRO_ADD(tests, pool_pop_and_stack_mode);
+    MACRO_ADD(tests, pool_compact_relocates);
+    MACRO_ADD(tests, pool_compact_in_place);
+    MACRO_ADD(tests, pool_compact_single_block_and_alignment);
+    MACRO_ADD(tests, pool_get_stats);
+    MACRO_ADD(tests, pool_alloc_batch_and_array);
+    MACRO_ADD(tests, pool_define_specialized);
+    MACRO_ADD(tests, pool_init_external);
+    MACRO_ADD(tests, pool_init_guarded);
+    MACRO_ADD(tests, pool_intern_and_split);
+    MACRO_ADD(tests, pool_intern_follows_allocator);
 
 
     macro_run_all("a-memory-library/aml_pool", tests, test_count);
@@ -0,0 +1,145 @@
+// SPDX-FileCopyrightText: 2019–2026 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai
+// SPDX-License-Identifier: Apache-2.0
+//
+// Maintainer: Andy Curtis <contactandyc@gmail.com>
+
+// test_aml_pool_depot.c
+#include "the-macro-library/macro_test.h"
+#include "a-memory-library/aml_pool_depot.h"
+#include "a-memory-library/aml_pool.h"
+#include "a-memory-library/aml_alloc.h"
+
+#include <string.h>
+#include <pthread.h>
+
+static void grow_and_clear(aml_pool_t *p) {
+    for (int i = 0; i < 20; i++) {
+        char *m = (char*)aml_pool_alloc(p, 512);
+        memset(m, i, 512);
+    }
+    aml_pool_clear(p);
+}
+
+MACRO_TEST(depot_disabled_by_default) {
+    size_t len = 100;
+    MACRO_ASSERT_TRUE(aml_pool_depot_alloc(&len) == NULL);
+    MACRO_ASSERT_EQ_SZ(len, 100);
+
+    void *block = aml_malloc(4096);
+    MACRO_ASSERT_TRUE(!aml_pool_depot_release(block, 4096));
+    aml_free(block);
+}
+
+MACRO_TEST(depot_size_classes) {
+    aml_pool_depot_enable(1024 * 1024);
+    size_t len = 100;
+    void *a = aml_pool_depot_alloc(&len);
+    MACRO_ASSERT_EQ_SZ(len, 4096);
+    len = 4097;
+    void *b = aml_pool_depot_alloc(&len);
+    MACRO_ASSERT_EQ_SZ(len, 8192);
+    len = (size_t)128 * 1024 * 1024;
+    MACRO_ASSERT_TRUE(aml_pool_depot_alloc(&len) == NULL);
+
+    MACRO_ASSERT_TRUE(aml_pool_depot_release(a, 4096));
+    // not the size of a class
+    MACRO_ASSERT_TRUE(!aml_pool_depot_release(b, 8000));
+    MACRO_ASSERT_TRUE(aml_pool_depot_release(b, 8192));
+
+    aml_pool_depot_trim();
+    aml_pool_depot_stats_t stats;
+    aml_pool_depot_stats(&stats);
+    MACRO_ASSERT_EQ_SZ(stats.cached_bytes, 0);
+    aml_pool_depot_enable(0);
+}
+
+MACRO_TEST(depot_pool_growth_hits) {
+    aml_pool_depot_enable(1024 * 1024);
+    aml_pool_t *p = aml_pool_init(1024);
+
+    aml_pool_depot_stats_t start, first, second;
+    aml_pool_depot_stats(&start);
+    grow_and_clear(p);
+    aml_pool_depot_stats(&first);
+    size_t grown = first.misses - start.misses;
+    MACRO_ASSERT_TRUE(grown > 0);
+    MACRO_ASSERT_EQ_SZ(first.hits, start.hits);
+    MACRO_ASSERT_TRUE(first.cached_bytes > 0);
+
+    // the second cycle is served entirely from the depot
+    grow_and_clear(p);
+    aml_pool_depot_stats(&second);
+    MACRO_ASSERT_EQ_SZ(second.misses, first.misses);
+    MACRO_ASSERT_EQ_SZ(second.hits - first.hits, grown);
+    MACRO_ASSERT_EQ_SZ(second.cached_bytes, first.cached_bytes);
+
+    aml_pool_destroy(p);
+    aml_pool_depot_trim();
+    aml_pool_depot_enable(0);
+}
+
+MACRO_TEST(depot_cap_overflows) {
+    aml_pool_depot_enable(8192);
+    aml_pool_t *p = aml_pool_init(1024);
+
+    aml_pool_depot_stats_t before, after;
+    aml_pool_depot_stats(&before);
+    grow_and_clear(p);
+    aml_pool_depot_stats(&after);
+    MACRO_ASSERT_TRUE(after.overflows > before.overflows);
+    MACRO_ASSERT_TRUE(after.cached_bytes <= 8192);
+    MACRO_ASSERT_EQ_SZ(after.max_cached_bytes, 8192);
+
+    aml_pool_destroy(p);
+    aml_pool_depot_trim();
+    aml_pool_depot_enable(0);
+}
+
+static void *depot_worker(void *arg) {
+    (void)arg;
+    for (int i = 0; i < 500; i++) {
+        aml_pool_t *p = aml_pool_init(1024);
+        grow_and_clear(p);
+        grow_and_clear(p);
+        aml_pool_destroy(p);
+    }
+    return NULL;
+}
+
+MACRO_TEST(depot_threads_share_blocks) {
+    aml_pool_depot_enable(4 * 1024 * 1024);
+    aml_pool_depot_stats_t before, after;
+    aml_pool_depot_stats(&before);
+
+    pthread_t threads[4];
+    for (int i = 0; i < 4; i++)
+        pthread_create(&threads[i], NULL, depot_worker, NULL);
+    for (int i = 0; i < 4; i++)
+        pthread_join(threads[i], NULL);
+
+    aml_pool_depot_stats(&after);
+    MACRO_ASSERT_TRUE(after.hits - before.hits > after.misses - before.misses);
+    MACRO_ASSERT_TRUE(after.cached_bytes <= 4 * 1024 * 1024);
+
+    // the threads' magazines were flushed to the global stacks as they exited
+    aml_pool_depot_trim();
+    aml_pool_depot_stats(&after);
+    MACRO_ASSERT_EQ_SZ(after.cached_bytes, 0);
+    aml_pool_depot_enable(0);
+}
+
+/* --- runner --- */
+int main(void) {
+    macro_test_case tests[16];
+    size_t test_count = 0;
+
+    MACRO_ADD(tests, depot_disabled_by_default);
+    MACRO_ADD(tests, depot_size_classes);
+    MACRO_ADD(tests, depot_pool_growth_hits);
+    MACRO_ADD(tests, depot_cap_overflows);
+    MACRO_ADD(tests, depot_threads_share_blocks);
+
+    macro_run_all("a-memory-library/aml_pool_depot", tests, test_count);
+    return 0;
+}
@@ -0,0 +1,136 @@
+// SPDX-FileCopyrightText: 2019–2026 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai
+// SPDX-License-Identifier: Apache-2.0
+//
+// Maintainer: Andy Curtis <contactandyc@gmail.com>
+
+// test_aml_pool_map.c
+#include "the-macro-library/macro_test.h"
+#include "a-memory-library/aml_pool_map.h"
+#include "a-memory-library/aml_pool.h"
+
+#include <stdio.h>
+#include <string.h>
+
+MACRO_TEST(map_str_insert_find_and_rehash) {
+    aml_pool_t *pool = aml_pool_init(4096);
+    aml_pool_map_t *m = aml_pool_map_str_init(pool, 0);
+    char key[32];
+    bool inserted;
+    for (int i = 0; i < 10000; i++) {
+        int len = snprintf(key, sizeof(key), "key-%d", i);
+        void **v = aml_pool_map_str_insert(m, key, len, &inserted);
+        MACRO_ASSERT_TRUE(inserted);
+        MACRO_ASSERT_TRUE(*v == NULL);
+        *v = (void *)(size_t)(i + 1);
+    }
+    MACRO_ASSERT_EQ_SZ(aml_pool_map_size(m), 10000);
+
+    for (int i = 0; i < 10000; i++) {
+        int len = snprintf(key, sizeof(key), "key-%d", i);
+        void **v = aml_pool_map_str_find(m, key, len);
+        MACRO_ASSERT_TRUE(v != NULL);
+        MACRO_ASSERT_EQ_SZ((size_t)*v, i + 1);
+    }
+    MACRO_ASSERT_TRUE(aml_pool_map_str_find(m, "key-10000", 9) == NULL);
+    MACRO_ASSERT_TRUE(aml_pool_map_str_find(m, "key-1", 4) == NULL);
+
+    // inserting again finds the existing entry
+    void **v = aml_pool_map_str_insert(m, "key-42", 6, &inserted);
+    MACRO_ASSERT_TRUE(!inserted);
+    MACRO_ASSERT_EQ_SZ((size_t)*v, 43);
+    MACRO_ASSERT_EQ_SZ(aml_pool_map_size(m), 10000);
+    aml_pool_destroy(pool);
+}
+
+MACRO_TEST(map_str_keys_are_copied) {
+    aml_pool_t *pool = aml_pool_init(1024);
+    aml_pool_map_t *m = aml_pool_map_str_init(pool, 100);
+    char key[16] = "abc";
+    *aml_pool_map_str_insert(m, key, 3, NULL) = key;
+    strcpy(key, "xyz");
+    MACRO_ASSERT_TRUE(aml_pool_map_str_find(m, "abc", 3) != NULL);
+    MACRO_ASSERT_TRUE(aml_pool_map_str_find(m, "xyz", 3) == NULL);
+
+    // keys are bytes, so embedded zeros and empty keys work
+    aml_pool_map_str_insert(m, "a\0b", 3, NULL);
+    aml_pool_map_str_insert(m, "", 0, NULL);
+    MACRO_ASSERT_TRUE(aml_pool_map_str_find(m, "a\0b", 3) != NULL);
+    MACRO_ASSERT_TRUE(aml_pool_map_str_find(m, "a\0c", 3) == NULL);
+    MACRO_ASSERT_TRUE(aml_pool_map_str_find(m, "a", 1) == NULL);
+    MACRO_ASSERT_TRUE(aml_pool_map_str_find(m, "", 0) != NULL);
+
+    size_t pos = 0, count = 0, len;
+    const char *k;
+    void *value;
+    while (aml_pool_map_str_next(m, &pos, &k, &len, &value)) {
+        if (len == 3 && !strcmp(k, "abc"))
+            MACRO_ASSERT_TRUE(value == key);
+        MACRO_ASSERT_TRUE(k[len] == 0);
+        count++;
+    }
+    MACRO_ASSERT_EQ_SZ(count, 3);
+    aml_pool_destroy(pool);
+}
+
+MACRO_TEST(map_int_keys) {
+    aml_pool_t *pool = aml_pool_init(4096);
+    aml_pool_map_t *m = aml_pool_map_int_init(pool, 0);
+    bool inserted;
+    // keys that only differ in their high bits, plus 0
+    for (uint64_t i = 0; i < 5000; i++) {
+        void **v = aml_pool_map_int_insert(m, i << 40, &inserted);
+        MACRO_ASSERT_TRUE(inserted);
+        *v = (void *)(size_t)(i * 3);
+    }
+    MACRO_ASSERT_EQ_SZ(aml_pool_map_size(m), 5000);
+    for (uint64_t i = 0; i < 5000; i++) {
+        void **v = aml_pool_map_int_find(m, i << 40);
+        MACRO_ASSERT_TRUE(v != NULL);
+        MACRO_ASSERT_EQ_SZ((size_t)*v, i * 3);
+    }
+    MACRO_ASSERT_TRUE(aml_pool_map_int_find(m, 1) == NULL);
+    aml_pool_map_int_insert(m, 0, &inserted);
+    MACRO_ASSERT_TRUE(!inserted);
+
+    size_t pos = 0, count = 0;
+    uint64_t key, sum = 0;
+    while (aml_pool_map_int_next(m, &pos, &key, NULL)) {
+        sum += key >> 40;
+        count++;
+    }
+    MACRO_ASSERT_EQ_SZ(count, 5000);
+    MACRO_ASSERT_EQ_SZ(sum, 4999 * 5000 / 2);
+    aml_pool_destroy(pool);
+}
+
+MACRO_TEST(map_size_hint_avoids_rehash) {
+    aml_pool_t *pool = aml_pool_init(256 * 1024);
+    aml_pool_map_t *m = aml_pool_map_int_init(pool, 1000);
+    char *a = (char *)aml_pool_alloc(pool, 8);
+    for (uint64_t i = 0; i < 1000; i++)
+        aml_pool_map_int_insert(m, i, NULL);
+    // integer entries live in the table, so nothing else was allocated
+    char *b = (char *)aml_pool_alloc(pool, 8);
+    MACRO_ASSERT_TRUE(b == a + 8);
+    for (uint64_t i = 1000; i < 5000; i++)
+        aml_pool_map_int_insert(m, i, NULL);
+    char *c = (char *)aml_pool_alloc(pool, 8);
+    MACRO_ASSERT_TRUE(c != b + 8);
+    MACRO_ASSERT_EQ_SZ(aml_pool_map_size(m), 5000);
+    aml_pool_destroy(pool);
+}
+
+/* --- runner --- */
+int main(void) {
+    macro_test_case tests[16];
+    size_t test_count = 0;
+
+    MACRO_ADD(tests, map_str_insert_find_and_rehash);
+    MACRO_ADD(tests, map_str_keys_are_copied);
+    MACRO_ADD(tests, map_int_keys);
+    MACRO_ADD(tests, map_size_hint_avoids_rehash);
+
+    macro_run_all("a-memory-library/aml_pool_map", tests, test_count);
+    return 0;
+}
@@ -0,0 +1,153 @@
+// SPDX-FileCopyrightText: 2019–2026 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai
+// SPDX-License-Identifier: Apache-2.0
+//
+// Maintainer: Andy Curtis <contactandyc@gmail.com>
+
+// test_aml_pool_mmap.c
+#include "the-macro-library/macro_test.h"
+#include "a-memory-library/aml_pool_mmap.h"
+#include "a-memory-library/aml_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct {
+    aml_relptr_t key;
+    aml_relptr_t next;
+    int value;
+} entry_t;
+
+static void temp_path(char *path) {
+    strcpy(path, "/tmp/test_aml_pool_mmap_XXXXXX");
+    int fd = mkstemp(path);
+    close(fd);
+}
+
+/* builds a list of 100 entries with the last one first */
+static entry_t *build_list(aml_pool_t *pool) {
+    entry_t *head = NULL;
+    char key[32];
+    for (int i = 0; i < 100; i++) {
+        entry_t *e = (entry_t *)aml_pool_zalloc(pool, sizeof(entry_t));
+        snprintf(key, sizeof(key), "key-%d", i);
+        aml_relptr_set(&e->key, aml_pool_strdup(pool, key));
+        aml_relptr_set(&e->next, head);
+        e->value = i * 10;
+        head = e;
+    }
+    return head;
+}
+
+static bool check_list(const entry_t *e) {
+    char key[32];
+    for (int i = 99; i >= 0; i--) {
+        if (!e || e->value != i * 10)
+            return false;
+        snprintf(key, sizeof(key), "key-%d", i);
+        if (strcmp((const char *)aml_relptr_get(&e->key), key))
+            return false;
+        e = (const entry_t *)aml_relptr_get(&e->next);
+    }
+    return e == NULL;
+}
+
+MACRO_TEST(relptr_basics) {
+    struct { aml_relptr_t a; aml_relptr_t b; char data[16]; } s = {0};
+    aml_relptr_set(&s.a, s.data);
+    aml_relptr_set(&s.b, NULL);
+    MACRO_ASSERT_TRUE(aml_relptr_get(&s.a) == s.data);
+    MACRO_ASSERT_TRUE(aml_relptr_get(&s.b) == NULL);
+    MACRO_ASSERT_TRUE(s.a == (aml_relptr_t)(s.data - (char *)&s.a));
+}
+
+MACRO_TEST(mmap_build_and_open) {
+    char path[64];
+    temp_path(path);
+    aml_pool_t *pool = aml_pool_mmap_init(path, 1024 * 1024);
+    MACRO_ASSERT_TRUE(pool != NULL);
+    entry_t *head = build_list(pool);
+    MACRO_ASSERT_TRUE(check_list(head));
+    aml_pool_mmap_set_root(pool, head);
+    MACRO_ASSERT_TRUE(aml_pool_mmap_sync(pool));
+
+    // a reader can map the file while the builder still has it
+    aml_pool_mmap_view_t view;
+    MACRO_ASSERT_TRUE(aml_pool_mmap_open(&view, path));
+    MACRO_ASSERT_TRUE(view.base != NULL);
+    MACRO_ASSERT_TRUE(view.root != (const void *)head);
+    MACRO_ASSERT_EQ_SZ((const char *)view.root - (const char *)view.base,
+                       aml_pool_mmap_offset(pool, head));
+    MACRO_ASSERT_TRUE(check_list((const entry_t *)view.root));
+    size_t length = view.length;
+    aml_pool_mmap_close(&view);
+    MACRO_ASSERT_TRUE(view.base == NULL);
+
+    // destroying the builder trims the file to what was synced
+    aml_pool_strdup(pool, "not synced");
+    aml_pool_destroy(pool);
+    struct stat st;
+    MACRO_ASSERT_TRUE(stat(path, &st) == 0);
+    MACRO_ASSERT_EQ_SZ((size_t)st.st_size, length);
+
+    MACRO_ASSERT_TRUE(aml_pool_mmap_open(&view, path));
+    MACRO_ASSERT_EQ_SZ(view.length, length);
+    MACRO_ASSERT_TRUE(check_list((const entry_t *)view.root));
+    aml_pool_mmap_close(&view);
+    unlink(path);
+}
+
+MACRO_TEST(mmap_open_rejects) {
+    char path[64];
+    temp_path(path);
+    aml_pool_mmap_view_t view;
+    // empty file
+    MACRO_ASSERT_TRUE(!aml_pool_mmap_open(&view, path));
+
+    // never synced
+    aml_pool_t *pool = aml_pool_mmap_init(path, 65536);
+    aml_pool_strdup(pool, "hello");
+    MACRO_ASSERT_TRUE(!aml_pool_mmap_open(&view, path));
+    aml_pool_destroy(pool);
+    MACRO_ASSERT_TRUE(!aml_pool_mmap_open(&view, path));
+    unlink(path);
+
+    MACRO_ASSERT_TRUE(!aml_pool_mmap_open(&view, "/nonexistent/aml_pool_mmap"));
+    MACRO_ASSERT_TRUE(aml_pool_mmap_init("/nonexistent/aml_pool_mmap", 65536) == NULL);
+    // too small to hold the headers
+    MACRO_ASSERT_TRUE(aml_pool_mmap_init(path, 16) == NULL);
+    unlink(path);
+}
+
+MACRO_TEST(mmap_no_root) {
+    char path[64];
+    temp_path(path);
+    aml_pool_t *pool = aml_pool_mmap_init(path, 65536);
+    char *s = aml_pool_strdup(pool, "no root");
+    MACRO_ASSERT_TRUE(aml_pool_mmap_sync(pool));
+    size_t offset = aml_pool_mmap_offset(pool, s);
+    aml_pool_destroy(pool);
+
+    aml_pool_mmap_view_t view;
+    MACRO_ASSERT_TRUE(aml_pool_mmap_open(&view, path));
+    MACRO_ASSERT_TRUE(view.root == NULL);
+    MACRO_ASSERT_STREQ((const char *)view.base + offset, "no root");
+    aml_pool_mmap_close(&view);
+    unlink(path);
+}
+
+/* --- runner --- */
+int main(void) {
+    macro_test_case tests[16];
+    size_t test_count = 0;
+
+    MACRO_ADD(tests, relptr_basics);
+    MACRO_ADD(tests, mmap_build_and_open);
+    MACRO_ADD(tests, mmap_open_rejects);
+    MACRO_ADD(tests, mmap_no_root);
+
+    macro_run_all("a-memory-library/aml_pool_mmap", tests, test_count);
+    return 0;
+}
@@ -0,0 +1,94 @@
+// SPDX-FileCopyrightText: 2019–2026 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai
+// SPDX-License-Identifier: Apache-2.0
+//
+// Maintainer: Andy Curtis <contactandyc@gmail.com>
+
+// test_aml_pool_resource.cpp
+#include "the-macro-library/macro_test.h"
+#include "a-memory-library/aml_pool.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+MACRO_TEST(resource_containers_use_pool) {
+    aml_pool_t *pool = aml_pool_init(1024);
+    aml::pool_resource resource(pool);
+    size_t before = aml_pool_used(pool);
+    {
+        std::pmr::vector<int> v(&resource);
+        for (int i = 0; i < 1000; i++)
+            v.push_back(i);
+        std::pmr::unordered_map<int, std::pmr::string> m(&resource);
+        for (int i = 0; i < 100; i++)
+            m.emplace(i, std::pmr::string(64, 'a' + i % 26, &resource));
+        MACRO_ASSERT_EQ_INT(v[999], 999);
+        MACRO_ASSERT_EQ_SZ(m.at(27).size(), 64);
+        MACRO_ASSERT_TRUE(m.at(27)[0] == 'b');
+        MACRO_ASSERT_TRUE(aml_pool_used(pool) > before + 1000 * sizeof(int));
+    }
+    aml_pool_clear(pool);
+    MACRO_ASSERT_EQ_SZ(aml_pool_blocks(pool), 1);
+    aml_pool_destroy(pool);
+}
+
+MACRO_TEST(resource_lifo_deallocate) {
+    aml_pool_t *pool = aml_pool_init(4096);
+    aml::pool_resource resource(pool);
+    void *a = resource.allocate(100);
+    void *b = resource.allocate(100);
+    // not the top, nothing happens
+    resource.deallocate(a, 100);
+    MACRO_ASSERT_TRUE(resource.allocate(8) != a);
+    void *c = resource.allocate(200);
+    resource.deallocate(c, 200);
+    MACRO_ASSERT_TRUE(resource.allocate(200) == c);
+    (void)b;
+
+    // a live one byte block after the first keeps it from being reused
+    char *first = static_cast<char *>(resource.allocate(8, 8));
+    char *byte = static_cast<char *>(resource.allocate(1, 1));
+    *byte = 'z';
+    resource.deallocate(first, 8, 8);
+    char *next = static_cast<char *>(resource.allocate(16, 8));
+    MACRO_ASSERT_TRUE(next > byte);
+    std::memset(next, 0, 16);
+    MACRO_ASSERT_TRUE(*byte == 'z');
+    aml_pool_destroy(pool);
+}
+
+MACRO_TEST(resource_alignment_and_equality) {
+    aml_pool_t *pool = aml_pool_init(4096);
+    aml::pool_resource resource(pool);
+    (void)resource.allocate(3, 1);
+    void *p = resource.allocate(64, 64);
+    MACRO_ASSERT_EQ_SZ(reinterpret_cast<std::uintptr_t>(p) & 63, 0);
+    void *q = resource.allocate(8, 8);
+    MACRO_ASSERT_EQ_SZ(reinterpret_cast<std::uintptr_t>(q) & 7, 0);
+
+    aml::pool_resource same(pool);
+    MACRO_ASSERT_TRUE(resource == same);
+    aml_pool_t *other_pool = aml_pool_init(1024);
+    aml::pool_resource other(other_pool);
+    MACRO_ASSERT_TRUE(resource != other);
+    MACRO_ASSERT_TRUE(resource != *std::pmr::new_delete_resource());
+    aml_pool_destroy(other_pool);
+    aml_pool_destroy(pool);
+}
+
+/* --- runner --- */
+int main(void) {
+    macro_test_case tests[16];
+    size_t test_count = 0;
+
+    MACRO_ADD(tests, resource_containers_use_pool);
+    MACRO_ADD(tests, resource_lifo_deallocate);
+    MACRO_ADD(tests, resource_alignment_and_equality);
+
+    macro_run_all("a-memory-library/aml_pool_resource", tests, test_count);
+    return 0;
+}
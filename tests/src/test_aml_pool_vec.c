@@ -0,0 +1,165 @@
+// SPDX-FileCopyrightText: 2019–2026 Andy Curtis <contactandyc@gmail.com>
+// SPDX-FileCopyrightText: 2024–2025 Knode.ai
+// SPDX-License-Identifier: Apache-2.0
+//
+// Maintainer: Andy Curtis <contactandyc@gmail.com>
+
+// test_aml_pool_vec.c
+#include "the-macro-library/macro_test.h"
+#include "a-memory-library/aml_pool_vec.h"
+#include "a-memory-library/aml_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+MACRO_TEST(vec_grows_in_place) {
+    aml_pool_t *pool = aml_pool_init(64 * 1024);
+    aml_pool_vec_t v;
+    aml_pool_vec_init(&v, pool, sizeof(int), 0);
+    MACRO_ASSERT_TRUE(v.data == NULL);
+    MACRO_ASSERT_EQ_SZ(v.size, 0);
+
+    aml_pool_vec_push_value(&v, int, 0);
+    char *data = v.data;
+    for (int i = 1; i < 1000; i++)
+        aml_pool_vec_push_value(&v, int, i);
+    // nothing else was allocated, so the array never moved
+    MACRO_ASSERT_TRUE(v.data == data);
+    MACRO_ASSERT_EQ_SZ(v.size, 1000);
+    MACRO_ASSERT_TRUE(v.capacity >= 1000);
+    for (int i = 0; i < 1000; i++)
+        MACRO_ASSERT_EQ_INT(aml_pool_vec_at(&v, int, i), i);
+
+    size_t used = aml_pool_used(pool);
+    MACRO_ASSERT_TRUE(aml_pool_vec_shrink_to_fit(&v) == data);
+    MACRO_ASSERT_EQ_SZ(v.capacity, 1000);
+    MACRO_ASSERT_TRUE(pool->curp == v.data + 1000 * sizeof(int));
+    MACRO_ASSERT_TRUE(aml_pool_used(pool) <= used);
+    aml_pool_destroy(pool);
+}
+
+MACRO_TEST(vec_copies_when_not_last) {
+    aml_pool_t *pool = aml_pool_init(64 * 1024);
+    aml_pool_vec_t v;
+    aml_pool_vec_init(&v, pool, sizeof(size_t), 4);
+    MACRO_ASSERT_EQ_SZ(v.capacity, 4);
+    for (size_t i = 0; i < 4; i++)
+        aml_pool_vec_push_value(&v, size_t, i * 3);
+    char *data = v.data;
+
+    // another allocation on top forces the next grow to copy and double
+    char *s = aml_pool_strdup(pool, "on top");
+    aml_pool_vec_push_value(&v, size_t, 12);
+    MACRO_ASSERT_TRUE(v.data != data);
+    MACRO_ASSERT_EQ_SZ(v.capacity, 8);
+    for (size_t i = 0; i < 5; i++)
+        MACRO_ASSERT_EQ_SZ(aml_pool_vec_at(&v, size_t, i), i * 3);
+    MACRO_ASSERT_STREQ(s, "on top");
+
+    // the copy is the last allocation again, shrink gives the tail back
+    aml_pool_vec_shrink_to_fit(&v);
+    MACRO_ASSERT_EQ_SZ(v.capacity, 5);
+
+    // once something else is on top shrinking does nothing
+    aml_pool_vec_push_value(&v, size_t, 15);
+    MACRO_ASSERT_EQ_SZ(v.capacity, 10);
+    aml_pool_alloc(pool, 16);
+    char *curp = pool->curp;
+    aml_pool_vec_shrink_to_fit(&v);
+    MACRO_ASSERT_EQ_SZ(v.capacity, 10);
+    MACRO_ASSERT_TRUE(pool->curp == curp);
+
+    // a short string after the vector is live data, not spare capacity
+    aml_pool_vec_init(&v, pool, sizeof(size_t), 8);
+    for (size_t i = 0; i < 3; i++)
+        aml_pool_vec_push_value(&v, size_t, i);
+    MACRO_ASSERT_TRUE(pool->curp == v.data + 8 * sizeof(size_t));
+    char *hi = aml_pool_strdup(pool, "hi");
+    aml_pool_vec_shrink_to_fit(&v);
+    MACRO_ASSERT_EQ_SZ(v.capacity, 8);
+    for (size_t i = 3; i < 8; i++)
+        aml_pool_vec_push_value(&v, size_t, i);
+    MACRO_ASSERT_TRUE(aml_pool_strdup(pool, "overwrite") > hi);
+    MACRO_ASSERT_STREQ(hi, "hi");
+    aml_pool_destroy(pool);
+}
+
+MACRO_TEST(vec_extend_reserve_clear) {
+    aml_pool_t *pool = aml_pool_init(1024);
+    aml_pool_vec_t v;
+    aml_pool_vec_init(&v, pool, sizeof(int), 0);
+    int items[100];
+    for (int i = 0; i < 100; i++)
+        items[i] = i;
+
+    int *first = (int *)aml_pool_vec_extend(&v, items, 3);
+    MACRO_ASSERT_TRUE((char *)first == v.data);
+    first = (int *)aml_pool_vec_extend(&v, items + 3, 97);
+    MACRO_ASSERT_EQ_INT(first[0], 3);
+    MACRO_ASSERT_EQ_SZ(v.size, 100);
+    MACRO_ASSERT_TRUE(!memcmp(v.data, items, sizeof(items)));
+    aml_pool_vec_extend(&v, NULL, 0);
+    MACRO_ASSERT_EQ_SZ(v.size, 100);
+
+    int *tail = (int *)aml_pool_vec_push_n(&v, 10);
+    for (int i = 0; i < 10; i++)
+        tail[i] = -i;
+    MACRO_ASSERT_EQ_SZ(v.size, 110);
+    MACRO_ASSERT_EQ_INT(aml_pool_vec_at(&v, int, 109), -9);
+
+    // larger than the pool's block size
+    aml_pool_vec_reserve(&v, 5000);
+    MACRO_ASSERT_EQ_SZ(v.capacity, 5000);
+    MACRO_ASSERT_EQ_INT(aml_pool_vec_at(&v, int, 99), 99);
+    aml_pool_vec_reserve(&v, 10);
+    MACRO_ASSERT_EQ_SZ(v.capacity, 5000);
+
+    aml_pool_vec_clear(&v);
+    MACRO_ASSERT_EQ_SZ(v.size, 0);
+    MACRO_ASSERT_EQ_SZ(v.capacity, 5000);
+    aml_pool_vec_push_value(&v, int, 7);
+    MACRO_ASSERT_EQ_INT(aml_pool_vec_at(&v, int, 0), 7);
+    aml_pool_destroy(pool);
+}
+
+MACRO_TEST(vec_backs_split) {
+    aml_pool_t *pool = aml_pool_init(4096);
+    // enough fields for the result to grow several times and cross blocks
+    char *line = (char *)aml_pool_alloc(pool, 3000);
+    char *wp = line;
+    for (int i = 0; i < 1000; i++)
+        wp += sprintf(wp, i ? ",%d" : "%d", i % 10);
+
+    size_t n = 0;
+    char **r = aml_pool_split(pool, &n, ',', line);
+    MACRO_ASSERT_EQ_SZ(n, 1000);
+    MACRO_ASSERT_TRUE(r[1000] == NULL);
+    for (int i = 0; i < 1000; i++)
+        MACRO_ASSERT_EQ_INT(r[i][0] - '0', i % 10);
+
+    char **e = aml_pool_split_with_escape(pool, &n, ',', '\\', line);
+    MACRO_ASSERT_EQ_SZ(n, 1000);
+    MACRO_ASSERT_TRUE(e[1000] == NULL);
+    MACRO_ASSERT_STREQ(e[999], "9");
+
+    const char **t = aml_pool_split_intern(pool, &n, ',', line);
+    MACRO_ASSERT_EQ_SZ(n, 1000);
+    MACRO_ASSERT_TRUE(t[1000] == NULL);
+    MACRO_ASSERT_TRUE(t[0] == t[10]);
+    MACRO_ASSERT_EQ_SZ(aml_pool_interned(pool), 10);
+    aml_pool_destroy(pool);
+}
+
+/* --- runner --- */
+int main(void) {
+    macro_test_case tests[16];
+    size_t test_count = 0;
+
+    MACRO_ADD(tests, vec_grows_in_place);
+    MACRO_ADD(tests, vec_copies_when_not_last);
+    MACRO_ADD(tests, vec_extend_reserve_clear);
+    MACRO_ADD(tests, vec_backs_split);
+
+    macro_run_all("a-memory-library/aml_pool_vec", tests, test_count);
+    return 0;
+}